@@ -0,0 +1,108 @@
+//
+// Created by ki608 on 2022-07-25.
+//
+
+#pragma once
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+
+/**
+ * Bounded, lock-free multi-producer single-consumer ring buffer.
+ *
+ * Producers reserve a contiguous range of cells with a single CAS, thus a batch of N
+ *  elements costs one atomic RMW regardless of N. Cells are published individually,
+ *  and consumer only reads the contiguous published prefix.
+ *
+ * If there is no room for the whole batch, push fails and nothing is written.
+ */
+template <typename Ty_>
+class MpscRing
+{
+    struct Cell {
+        std::atomic_size_t seq{0};
+        Ty_ value = {};
+    };
+
+    static constexpr size_t CACHE_LINE = 64;
+
+   private:
+    std::unique_ptr<Cell[]> _cells;
+    size_t _mask = 0;
+
+    alignas(CACHE_LINE) std::atomic_size_t _tail{0};
+    alignas(CACHE_LINE) std::atomic_size_t _head{0};
+
+   public:
+    explicit MpscRing(size_t capacityPow2)
+            : _cells(new Cell[capacityPow2]),
+              _mask(capacityPow2 - 1)
+    {
+        assert(capacityPow2 > 0 && (capacityPow2 & _mask) == 0);
+    }
+
+    size_t Capacity() const noexcept { return _mask + 1; }
+
+    /**
+     * Consumer side may regard false as 'definitely empty'. From producer side, it's a hint.
+     */
+    bool Empty() const noexcept
+    {
+        return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+    }
+
+   public:
+    /**
+     * Multi-producer safe.
+     */
+    bool TryPush(Ty_ const& value) noexcept { return TryPushN(&value, 1); }
+
+    /**
+     * Multi-producer safe. Pushes all elements, or none.
+     */
+    template <typename Iter_>
+    bool TryPushN(Iter_ begin, size_t n) noexcept
+    {
+        if (n == 0) { return true; }
+        if (n > Capacity()) { return false; }
+
+        size_t pos = _tail.load(std::memory_order_relaxed);
+
+        do {
+            if (pos + n - _head.load(std::memory_order_acquire) > Capacity())
+                return false;
+        } while (not _tail.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed));
+
+        for (size_t i = 0; i < n; ++i, ++begin) {
+            auto& cell = _cells[(pos + i) & _mask];
+            cell.value = *begin;
+            cell.seq.store(pos + i + 1, std::memory_order_release);
+        }
+
+        return true;
+    }
+
+    /**
+     * Single consumer only. Invokes fn(Ty_&) for every published element in order.
+     *
+     * @return Number of consumed elements
+     */
+    template <typename Fn_>
+    size_t ConsumeAll(Fn_&& fn)
+    {
+        size_t const head = _head.load(std::memory_order_relaxed);
+        size_t pos = head;
+
+        for (;; ++pos) {
+            auto& cell = _cells[pos & _mask];
+            if (cell.seq.load(std::memory_order_acquire) != pos + 1) { break; }
+
+            fn(cell.value);
+        }
+
+        // Release consumed cells at once, after every read is done.
+        _head.store(pos, std::memory_order_release);
+        return pos - head;
+    }
+};
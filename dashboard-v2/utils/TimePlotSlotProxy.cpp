@@ -8,18 +8,52 @@
 
 void TimePlotSlotProxy::Commit(double d)
 {
-    VerifyMainThread();
+    Commit(d, steady_clock::now());
+}
 
+void TimePlotSlotProxy::Commit(double d, steady_clock::time_point timestamp)
+{
+    TimePlot::Point pt{timestamp, d};
+    CommitBatch(&pt, 1);
+}
+
+void TimePlotSlotProxy::CommitBatch(TimePlot::Point const* points, size_t count)
+{
     if (not _body) {
         return;
     } else if (_body->bMarkDestroied) {
         _body.reset();
         return;
+    } else if (count == 0) {
+        return;
     }
 
-    _body->pointsPendingUploaded.push_back({steady_clock::now(), d});
-    _body->uploadSequence++;
-    _body->timeLastUpload = steady_clock::now();
+    // Batches larger than the ring are pushed in ring sized pieces, halved on failure to
+    //  fill remaining space. Once not even a point fits, rest of the batch is dropped.
+    auto& ring = _body->pointsPendingUploaded;
+    auto n = std::min(count, ring.Capacity());
+    size_t numPushed = 0;
+
+    while (numPushed < count) {
+        n = std::min(n, count - numPushed);
+
+        if (ring.TryPushN(points + numPushed, n)) {
+            numPushed += n;
+        } else if (n > 1) {
+            n /= 2;
+        } else {
+            break;
+        }
+    }
+
+    if (numPushed > 0) {
+        _body->uploadSequence.fetch_add(numPushed, std::memory_order_relaxed);
+        _body->timeLastUpload.store(steady_clock::now(), std::memory_order_relaxed);
+    }
+
+    if (numPushed < count) {
+        _body->numDroppedPoints.fetch_add(count - numPushed, std::memory_order_relaxed);
+    }
 }
 
 void TimePlotSlotProxy::Expire()
@@ -4,6 +4,7 @@
 
 #pragma once
 #include <chrono>
+#include <iterator>
 
 using std::chrono::microseconds;
 
@@ -11,6 +12,7 @@ class TimePlotWindowManager;
 
 namespace TimePlot {
 class SlotData;
+struct Point;
 }
 
 class TimePlotSlotProxy
@@ -21,7 +23,39 @@ class TimePlotSlotProxy
     shared_ptr<TimePlot::SlotData> _body;
 
    public:
+    /**
+     * Thread-safe. Points are queued lock-free, and drained by plot cache builder.
+     *
+     * A proxy instance itself must not be shared between threads, while any number of
+     *  proxy copies referring to the same slot can commit concurrently.
+     */
     void Commit(double);
+
+    /**
+     * Commit value with explicit timestamp, e.g. when the value was produced rather than
+     *  when it arrived. Thread-safe. Ordering rule of CommitBatch() applies.
+     */
+    void Commit(double, steady_clock::time_point);
+
+    /**
+     * Commit multiple points with single queue operation. Points are expected to be sorted
+     *  by timestamp. Thread-safe.
+     *
+     * Batches larger than the queue are split. Points not fitting in the queue are dropped,
+     *  and the count is shown on the slot.
+     *
+     * Points older than the latest point already drained into the slot are dropped and
+     *  counted as well, as history can only be appended. Points drained together are
+     *  sorted first, thus producers racing within a cache interval keep their timestamps.
+     */
+    void CommitBatch(TimePlot::Point const* points, size_t count);
+
+    template <typename Range_>
+    void CommitBatch(Range_ const& points)
+    {
+        CommitBatch(std::data(points), std::size(points));
+    }
+
     void Expire();
     void EnableUserRemove(bool value = true);
 
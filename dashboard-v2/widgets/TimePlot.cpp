@@ -4,6 +4,8 @@
 
 #include "TimePlot.hpp"
 
+#include <thread>
+
 #include "Application.hpp"
 #include "cpph/helper/macros.hxx"
 #include "cpph/utility/chrono.hxx"
@@ -12,7 +14,9 @@
 #include "imgui.h"
 #include "imgui_extension.h"
 #include "implot.h"
+#include "implot_internal.h"
 #include "perfkit/configs.h"
+#include "widgets/timeplot/Archive.hpp"
 
 PERFKIT_DECLARE_SUBCATEGORY(GConfig::Widgets)
 {
@@ -21,11 +25,28 @@ PERFKIT_DECLARE_SUBCATEGORY(GConfig::Widgets)
         string title;
         bool bIsDisplayed;
         bool bTimePlotMode;
+        int decimation = int(TimePlot::EDecimation::MinMax);
 
-        CPPH_REFL_DEFINE_OBJECT_inline_simple(key, title, bIsDisplayed, bTimePlotMode);
+        CPPH_REFL_DEFINE_OBJECT_inline_simple(key, title, bIsDisplayed, bTimePlotMode, decimation);
     };
 
     PERFKIT_CONFIGURE(TimePlotWindows, vector<PlotWindow>{}).confirm();
+
+    // Draw plot lines from GPU vertex buffers, instead of ImPlot's CPU tessellation.
+    PERFKIT_CONFIGURE(TimePlotGpuRender, true).confirm();
+
+    // Number of threads building plot cache. 0 to use all cores.
+    PERFKIT_CONFIGURE(TimePlotCacheWorkers, 0).confirm();
+
+    // Move compressed history exceeding memory budget to temporary file, instead of
+    //  discarding them.
+    PERFKIT_CONFIGURE(TimePlotSpillHistory, true).confirm();
+
+    // Compressed history kept in memory, in megabytes. Shared evenly by every slot.
+    PERFKIT_CONFIGURE(TimePlotHistoryBudgetMB, 256).confirm();
+
+    // Value encoding of compressed history. 0: Raw, 1: Float32, 2: XOR
+    PERFKIT_CONFIGURE(TimePlotHistoryCodec, int(TimePlot::EValueCodec::Xor)).confirm();
 }
 
 TimePlotWindowManager::TimePlotWindowManager()
@@ -40,6 +61,9 @@ TimePlotWindowManager::TimePlotWindowManager()
                     newWnd->bIsDisplayed = l.bIsDisplayed;
                     newWnd->bFollowGraphMovement = not l.bTimePlotMode;
                     newWnd->frameInfo.bTimeBuildMode = l.bTimePlotMode;
+
+                    if (0 <= l.decimation && l.decimation < int(TimePlot::EDecimation::_Count))
+                        newWnd->frameInfo.decimation = TimePlot::EDecimation(l.decimation);
                 }
 
                 _widget.bShowListPanel = RefPersistentNumber("TimePlotPersistant");
@@ -56,17 +80,19 @@ TimePlotWindowManager::TimePlotWindowManager()
                     elem.title = wnd->title;
                     elem.bIsDisplayed = wnd->bIsDisplayed;
                     elem.bTimePlotMode = wnd->frameInfo.bTimeBuildMode;
+                    elem.decimation = int(wnd->frameInfo.decimation);
                 }
 
                 GConfig::Widgets::TimePlotWindows.commit(wnds);
                 RefPersistentNumber("TimePlotPersistant") = _widget.bShowListPanel;
             };
+}
 
-    //
-    _cacheRender[0].reserve(1 << 16);
-    _cacheRender[1].reserve(1 << 16);
-    _async.cacheBuild[0].reserve(1 << 16);
-    _async.cacheBuild[1].reserve(1 << 16);
+TimePlotWindowManager::~TimePlotWindowManager()
+{
+    // Wait for running cache and archive jobs, which refer to this instance.
+    _asyncWorker.reset();
+    _archiveWorker.reset();
 }
 
 auto TimePlotWindowManager::CreateSlot(string name) -> TimePlotSlotProxy
@@ -79,7 +105,6 @@ auto TimePlotWindowManager::CreateSlot(string name) -> TimePlotSlotProxy
     proxy._body = data;
 
     data->name = std::move(name);
-    data->pointsPendingUploaded.reserve(256);
 
     std::mt19937_64 mt{std::random_device{}()};
     std::uniform_real_distribution<float> range{0.3, 1};
@@ -92,6 +117,44 @@ auto TimePlotWindowManager::CreateSlot(string name) -> TimePlotSlotProxy
     return proxy;
 }
 
+bool TimePlotWindowManager::CreateDerivedSlot(string name, string_view expression, string* error)
+{
+    VerifyMainThread();
+
+    auto evaluator = TimePlot::Expression::Parse(expression, error);
+    if (not evaluator) { return false; }
+
+    auto source = make_unique<TimePlot::SlotData::DerivedSource>();
+
+    for (auto& inputName : evaluator->InputNames()) {
+        auto iter = find_if(_slots.begin(), _slots.end(),
+                            [&](auto& slot) { return slot->name == inputName && not slot->bMarkDestroied; });
+
+        if (iter == _slots.end()) {
+            *error = fmt::format("slot '{}' not found", inputName);
+            return false;
+        }
+
+        // Derived slots are evaluated after every primary slot is drained, thus they can't
+        //  be chained.
+        if ((**iter).derived) {
+            *error = fmt::format("derived slot '{}' can't be an input", inputName);
+            return false;
+        }
+
+        source->inputs.push_back(*iter);
+    }
+
+    source->expression = string{expression};
+    source->evaluator = std::move(evaluator);
+    source->cursors.resize(source->inputs.size());
+    source->latest.resize(source->inputs.size(), NAN);
+
+    auto proxy = CreateSlot(std::move(name));
+    proxy._body->derived = std::move(source);
+    return true;
+}
+
 void TimePlotWindowManager::TickWindow()
 {
     using namespace ImGui;
@@ -107,12 +170,35 @@ void TimePlotWindowManager::TickWindow()
      * 6. 메인 스레드에서 cache swap 수행.
      */
     /// Validate cache
+    if (not _caching && not _bArchiveRunning && not _archiveJobs.empty()) {
+        _fnTriggerArchiveJob();
+    }
+
     bool const bAsyncJobTriggerFrame = not _caching && _timerCacheTrig.check();
-    bool const bCacheReceivedThisFrame = exchange(_cacheRecvFrame, false);
     if (bAsyncJobTriggerFrame) {
         _fnTriggerAsyncJob();
     }
 
+    // Vertices are only built on cache swap while GPU path is enabled, thus build them
+    //  from current caches as it's turned on.
+    if (bool bGpuRender = *GConfig::Widgets::TimePlotGpuRender; bGpuRender != _bGpuRender) {
+        _bGpuRender = bGpuRender;
+
+        if (bGpuRender) {
+            for (auto& slot : _slots)
+                if (auto wnd = slot->targetWindow.lock()) { _buildSlotVertices(wnd.get(), slot.get()); }
+        }
+    }
+
+    for (auto& wnd : _windows) {
+        wnd->lineRenderer.NewFrame();
+
+        if (wnd->bVerticesDirty && *GConfig::Widgets::TimePlotGpuRender && TimePlot::LineRenderer::Available()) {
+            wnd->bVerticesDirty = false;
+            wnd->lineRenderer.Upload(wnd->cacheVertices.data(), wnd->cacheVertices.size() / 2);
+        }
+    }
+
     /// Render MenuBar
     if (CondInvoke(BeginMainMenuBar(), &EndMainMenuBar)) {
         if (CondInvoke(BeginMenu(LOCWORD("View")), &EndMenu)) {
@@ -123,8 +209,10 @@ void TimePlotWindowManager::TickWindow()
 
     /// Render Main Window
 
-    if (not _widget.bShowListPanel)
+    if (not _widget.bShowListPanel) {
+        _crosshair.bActive = false;
         return;
+    }
 
     ImGui::SetNextWindowSize({640, 480}, ImGuiCond_Once);
     if (CPPH_CLEANUP(&End); Begin(LOCWORD("Time Plot List"), &_widget.bShowListPanel, ImGuiWindowFlags_MenuBar)) {
@@ -154,6 +242,40 @@ void TimePlotWindowManager::TickWindow()
                     }
                 }
             }
+
+            if (CondInvoke(ImGui::BeginMenu(LOCWORD("Archive")), &ImGui::EndMenu)) {
+                ImGui::InputText(LOCWORD("Path"), _widget.archivePath);
+
+                if (ImGui::MenuItem(LOCWORD("Export Visible"))) {
+                    ExportArchive(_widget.archivePath, true);
+                } else if (ImGui::MenuItem(LOCWORD("Export All"))) {
+                    ExportArchive(_widget.archivePath, false);
+                } else if (ImGui::MenuItem(LOCWORD("Import"))) {
+                    ImportArchive(_widget.archivePath);
+                }
+
+                if (not _archiveJobs.empty()) {
+                    ImGui::TextDisabled("%zu pending", _archiveJobs.size());
+                }
+            }
+
+            if (CondInvoke(ImGui::BeginMenu(LOCWORD("Derived")), &ImGui::EndMenu)) {
+                auto& w = _widget;
+                ImGui::InputText(LOCWORD("Name"), w.derivedName);
+                ImGui::InputText(LOCWORD("Expression"), w.derivedExpression);
+                ImGui::TextDisabled("{slot name}, + - * /, deriv(x), ma(x, N), ewma(x, alpha)");
+
+                if (ImGui::Button(LOCWORD("+ Create New"), {-1, 0})) {
+                    auto name = w.derivedName.empty() ? w.derivedExpression : w.derivedName;
+
+                    if (string error; CreateDerivedSlot(std::move(name), w.derivedExpression, &error)) {
+                        w.derivedName.clear();
+                        w.derivedExpression.clear();
+                    } else {
+                        NotifyToast{LOCWORD("Derived Series")}.Error().String(error);
+                    }
+                }
+            }
         }
 
         /// Render list of slots
@@ -161,7 +283,7 @@ void TimePlotWindowManager::TickWindow()
 
         for (auto& slot : _slots) {
             auto spinChars = "*|/-\\|/-"sv;
-            bool bLatest = (timeNow - slot->timeLastUpload) < 1s;
+            bool bLatest = (timeNow - slot->timeLastUpload.load()) < 1s;
             bool bFocusRenderedWindow = slot->bFocusRequested;
             slot->bFocusRequested = false;
 
@@ -188,7 +310,7 @@ void TimePlotWindowManager::TickWindow()
 
             ImGui::PushStyleColor(ImGuiCol_Text, bLatest ? ColorRefs::FrontOkay : ColorRefs::BackOkay);
             ImGui::SameLine();
-            ImGui::Text("[%c]", spinChars[slot->uploadSequence % spinChars.size()]);
+            ImGui::Text("[%c]", spinChars[slot->uploadSequence.load() % spinChars.size()]);
             ImGui::SameLine();
 
             if (auto wnd = slot->targetWindow.lock()) {
@@ -204,8 +326,29 @@ void TimePlotWindowManager::TickWindow()
             ImGui::SameLine();
             ImGui::TextUnformatted(slot->name.c_str());
 
+            if (slot->derived && slot->name != slot->derived->expression) {
+                ImGui::SameLine();
+                ImGui::TextDisabled("= %s", slot->derived->expression.c_str());
+            }
+
             ImGui::PopStyleColor(2);
 
+            auto const numDropped = slot->numDroppedPoints.load(std::memory_order_relaxed);
+            auto const numLate = slot->numLatePoints.load(std::memory_order_relaxed);
+
+            if (numDropped + numLate > 0) {
+                ImGui::PushStyleColor(ImGuiCol_Text, ColorRefs::FrontWarn);
+                ImGui::SameLine();
+                ImGui::Text("(%zu %s)", numDropped + numLate, LOCTEXT("dropped"));
+                ImGui::PopStyleColor();
+
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("%zu %s\n%zu %s",
+                                      numDropped, LOCTEXT("committed faster than plot cache drains them"),
+                                      numLate, LOCTEXT("older than latest point of the slot"));
+                }
+            }
+
             if (CondInvoke(ImGui::BeginPopup("##POPUP_SEL"), &EndPopup)) {
                 if (not slot->bDisableUserRemove && ImGui::MenuItem("Remove")) {
                     slot->bFocusRequested = true;
@@ -256,16 +399,21 @@ void TimePlotWindowManager::TickWindow()
         }
     }
 
-    decltype(1.s) deltaTime;
-    if (bCacheReceivedThisFrame) {
-        deltaTime = _tmTimeplotDelta.elapsed();
-        _tmTimeplotDelta.reset();
-    }
-
     /// Iterate each window, and display if needed.
+    bool bAnyPlotHovered = false;
+    CPPH_FINALLY(_crosshair.bActive = bAnyPlotHovered);
+
     for (auto& wnd : _windows) {
         CPPH_FINALLY(wnd->plotsThisFrame.clear());
 
+        bool const bCacheReceivedThisFrame = wnd->bCacheReceived;
+        wnd->bCacheReceived = false;
+        decltype(1.s) deltaTime = {};
+        if (bCacheReceivedThisFrame) {
+            deltaTime = wnd->tmCacheDelta.elapsed();
+            wnd->tmCacheDelta.reset();
+        }
+
         if (not wnd->bIsDisplayed) {
             continue;
         }
@@ -291,6 +439,18 @@ void TimePlotWindowManager::TickWindow()
                 ImGui::InputText("##Title", wnd->title);
                 ImGui::Checkbox(LOCWORD("Time Plot"), &bIsTimeBuildMode);
                 ImGui::Checkbox(usprintf("%s###CHKBOX", wnd->bFollowGraphMovement ? LOCWORD("Follow Plot") : LOCWORD("Fix Plot")), &wnd->bFollowGraphMovement);
+
+                auto& decimation = wnd->frameInfo.decimation;
+                if (CondInvoke(ImGui::BeginMenu(usprintf("%s###DECIMATION", ToString(decimation))), &ImGui::EndMenu)) {
+                    for (int i = 0; i < int(TimePlot::EDecimation::_Count); ++i) {
+                        auto mode = TimePlot::EDecimation(i);
+
+                        if (ImGui::MenuItem(ToString(mode), nullptr, mode == decimation) && mode != decimation) {
+                            decimation = mode;
+                            wnd->bDirty = true;
+                        }
+                    }
+                }
             }
 
             if (CondInvoke(ImPlot::BeginPlot(usprintf("###%p", wnd->title.c_str(), wnd.get()), {-1, -1}), ImPlot::EndPlot)) {
@@ -334,9 +494,13 @@ void TimePlotWindowManager::TickWindow()
                     }
                 }
 
+                bool bLegendHovered = false;
                 for (auto slot : wnd->plotsThisFrame) {
-                    DrawPlotContent(slot);
+                    DrawPlotContent(wnd.get(), slot);
+                    bLegendHovered |= ImPlot::IsLegendEntryHovered(slot->name.c_str());
                 }
+
+                bAnyPlotHovered |= _drawCrosshair(wnd.get(), not bLegendHovered);
             }
 
             if (ImGui::BeginDragDropTarget()) {
@@ -355,93 +519,515 @@ void TimePlotWindowManager::TickWindow()
     }
 }
 
-void TimePlotWindowManager::DrawPlotContent(TimePlot::SlotData* slot)
+void TimePlotWindowManager::DrawPlotContent(TimePlot::WindowContext* wnd, TimePlot::SlotData* slot)
 {
     auto [i1, i2] = slot->cacheAxisRange;
-    auto& [rX, rY] = _cacheRender;
+    auto& [rX, rY] = wnd->cacheRender;
 
-    if (i2 - i1 == 0) { return; }
+    if (i2 - i1 == 0 || i2 > rX.size()) { return; }
 
     ImPlot::PushStyleColor(ImPlotCol_Line, slot->plotColor);
-    ImPlot::PlotLine(slot->name.c_str(), &rX[i1], &rY[i1], i2 - i1);
+
+    if (*GConfig::Widgets::TimePlotGpuRender && TimePlot::LineRenderer::Available()) {
+        // Register as plot item for legend and auto-fit, while lines are drawn by GPU.
+        if (ImPlot::BeginItem(slot->name.c_str())) {
+            if (ImPlot::FitThisFrame()) {
+                for (auto i = i1; i < i2; ++i) { ImPlot::FitPoint({rX[i], rY[i]}); }
+            }
+
+            wnd->lineRenderer.Draw(i1, i2 - i1, rX[i1], ImPlot::GetLastItemColor(), ImPlot::GetStyle().LineWeight);
+            ImPlot::EndItem();
+        }
+    } else {
+        ImPlot::PlotLine(slot->name.c_str(), &rX[i1], &rY[i1], i2 - i1);
+    }
 
     ImPlot::PopStyleColor();
+
+    if (ImPlot::IsLegendEntryHovered(slot->name.c_str())) {
+        _drawStatisticsTooltip(slot);
+    }
+}
+
+bool TimePlotWindowManager::_drawCrosshair(TimePlot::WindowContext* wnd, bool bShowValues)
+{
+    auto const& axis = wnd->axis;
+    auto const bTimeBuild = wnd->frameInfo.bTimeBuildMode;
+
+    // Cache was never received, thus there's nothing to refer.
+    if (axis.now == steady_clock::time_point{}) { return false; }
+
+    bool const bHovered = ImPlot::IsPlotHovered();
+    if (bHovered) {
+        _crosshair.time = axis.FromPlot(ImPlot::GetPlotMousePos().x, bTimeBuild);
+    } else if (not _crosshair.bActive) {
+        return false;
+    }
+
+    // Crosshair is shared by all windows, thus time is mapped with axis of each window.
+    auto const px = ImPlot::PlotToPixels(axis.ToPlot(_crosshair.time, bTimeBuild), 0).x;
+    auto const pos = ImPlot::GetPlotPos();
+    auto const size = ImPlot::GetPlotSize();
+
+    if (pos.x <= px && px <= pos.x + size.x) {
+        ImPlot::PushPlotClipRect();
+        ImPlot::GetPlotDrawList()->AddLine({px, pos.y}, {px, pos.y + size.y}, ImGui::GetColorU32(ImGuiCol_Text, 0.5f));
+        ImPlot::PopPlotClipRect();
+    }
+
+    if (not bHovered || not bShowValues || wnd->plotsThisFrame.empty()) { return bHovered; }
+
+    ImGui::BeginTooltip();
+    CPPH_FINALLY(ImGui::EndTooltip());
+
+    if (CondInvoke(ImGui::BeginTable("##CROSSHAIR", 2, ImGuiTableFlags_SizingFixedFit), &ImGui::EndTable)) {
+        for (auto slot : wnd->plotsThisFrame) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(), ImGui::TextColored(slot->plotColor, "%s", slot->name.c_str());
+            ImGui::TableNextColumn();
+
+            if (std::isnan(slot->crosshairValue))
+                ImGui::TextDisabled("-");
+            else
+                ImGui::Text("%.6g", slot->crosshairValue);
+        }
+    }
+
+    return bHovered;
+}
+
+void TimePlotWindowManager::_drawStatisticsTooltip(TimePlot::SlotData* slot)
+{
+    auto& st = slot->stats;
+
+    ImGui::BeginTooltip();
+    CPPH_FINALLY(ImGui::EndTooltip());
+
+    ImGui::TextColored(slot->plotColor, "%s", slot->name.c_str());
+
+    auto const numDropped = slot->numDroppedPoints.load(std::memory_order_relaxed);
+    auto const numLate = slot->numLatePoints.load(std::memory_order_relaxed);
+
+    if (numDropped + numLate > 0) {
+        ImGui::PushStyleColor(ImGuiCol_Text, ColorRefs::FrontWarn);
+        if (numDropped) { ImGui::Text("%zu %s", numDropped, LOCTEXT("points dropped, as queue was full")); }
+        if (numLate) { ImGui::Text("%zu %s", numLate, LOCTEXT("points dropped, as they arrived out of order")); }
+        ImGui::PopStyleColor();
+    }
+
+    ImGui::Separator();
+
+    if (st.count == 0) {
+        ImGui::TextDisabled("%s", LOCTEXT("No visible samples"));
+        return;
+    }
+
+    if (CondInvoke(ImGui::BeginTable("##STATS", 2, ImGuiTableFlags_SizingFixedFit), &ImGui::EndTable)) {
+        auto fnRow
+                = [](char const* label, char const* fmt, auto value) {
+                      ImGui::TableNextRow();
+                      ImGui::TableNextColumn(), ImGui::TextUnformatted(label);
+                      ImGui::TableNextColumn(), ImGui::Text(fmt, value);
+                  };
+
+        fnRow(LOCWORD("Samples"), "%zu", st.count);
+        fnRow(LOCWORD("Mean"), "%.6g", st.mean);
+        fnRow(LOCWORD("Std. Dev"), "%.6g", st.stddev);
+        fnRow("p50", "%.4g", st.p50);
+        fnRow("p90", "%.4g", st.p90);
+        fnRow("p95", "%.4g", st.p95);
+        fnRow("p99", "%.4g", st.p99);
+    }
+}
+
+void TimePlotWindowManager::_fnAsyncValidateCache(size_t shardIndex)
+{
+    // Slots are picked one by one from shared cursor, thus heavy slots won't stall
+    //  a single shard while others are idle.
+    auto pseudo = &_async.shardSamples[shardIndex];
+    auto drained = &_async.shardDrained[shardIndex];
+
+    auto const targetEnd = _async.bDerivedPhase ? _async.targets.size() : _async.numPrimaryTargets;
+
+    for (size_t idx; (idx = _async.targetCursor.fetch_add(1)) < targetEnd;) {
+        auto slot = _async.targets[idx].get();
+        _fnAsyncDrainUploads(slot, drained);
+
+        if (slot->async.bPlotted) {
+            _fnAsyncBuildSlotCache(slot, pseudo);
+        }
+    }
+
+    if (_async.numPendingShards.fetch_sub(1) != 1) { return; }
+
+    // Last shard of first phase starts building derived slots, as every primary slot is
+    //  drained now.
+    if (not _async.bDerivedPhase && _async.numPrimaryTargets < _async.targets.size()) {
+        _async.bDerivedPhase = true;
+        _async.targetCursor = _async.numPrimaryTargets;
+        _postCacheShards(_async.targets.size() - _async.numPrimaryTargets);
+        return;
+    }
+
+    // Last shard finishing its job merges all outputs.
+    _fnAsyncLookupCrosshair();
+    _fnAsyncMergeCache();
+}
+
+void TimePlotWindowManager::_fnAsyncDrainUploads(TimePlot::SlotData* slot, vector<TimePlot::Point>* drained)
+{
+    drained->clear();
+
+    if (slot->derived)
+        _fnAsyncEvaluateDerived(slot, drained);
+    else
+        slot->pointsPendingUploaded.ConsumeAll([drained](TimePlot::Point& pt) { drained->push_back(pt); });
+
+    slot->async.spill.Configure(_async.historyCodec, _async.historyBudget, _async.bSpillHistory);
+    _fnAsyncAppendPoints(slot, drained);
+}
+
+void TimePlotWindowManager::_fnAsyncAppendPoints(TimePlot::SlotData* slot, vector<TimePlot::Point>* drained)
+{
+    if (drained->empty()) { return; }
+
+    auto& async = slot->async;
+    auto& allV = async.allValues;
+
+    // Concurrent producers may publish points slightly out of order. As every lookup
+    //  relies on binary search, keep allValues sorted.
+    auto fnCompare = [](auto& a, auto& b) { return a.timestamp < b.timestamp; };
+    if (not std::is_sorted(drained->begin(), drained->end(), fnCompare)) {
+        std::stable_sort(drained->begin(), drained->end(), fnCompare);
+    }
+
+    // History is append only, thus points older than the latest one can't be merged into
+    //  place. They are rejected and counted, rather than moved to another timestamp.
+    if (allV.size() > 0) {
+        auto const latest = allV.back().timestamp;
+        auto const numLate = std::lower_bound(
+                                     drained->begin(), drained->end(), latest,
+                                     [](auto& pt, auto& tp) { return pt.timestamp < tp; })
+                             - drained->begin();
+
+        if (numLate > 0) {
+            drained->erase(drained->begin(), drained->begin() + numLate);
+            slot->numLatePoints.fetch_add(size_t(numLate), std::memory_order_relaxed);
+            if (drained->empty()) { return; }
+        }
+    }
+
+    if (allV.capacity() - allV.size() < drained->size() && allV.capacity() < MAX_ENTITY) {
+        allV.reserve_shrink(min(MAX_ENTITY, max(allV.capacity() * 4, allV.size() + drained->size())));
+    }
+
+    // Points about to be overwritten are moved to history store, instead of being discarded.
+    if (auto numOverflow = allV.size() + drained->size(); numOverflow > allV.capacity()) {
+        numOverflow -= allV.capacity();
+
+        auto numFromQueue = min(numOverflow, allV.size());
+        async.spill.Append(allV.begin(), std::next(allV.begin(), numFromQueue));
+        async.spill.Append(drained->begin(), std::next(drained->begin(), numOverflow - numFromQueue));
+    }
+
+    allV.enqueue_n(drained->begin(), drained->size());
+    async.numAppended += drained->size();
+
+    async.pyramid.Append(drained->begin(), drained->end());
+    async.pyramid.EvictBefore(allV.front().timestamp);
+}
+
+void TimePlotWindowManager::_fnAsyncEvaluateDerived(TimePlot::SlotData* slot, vector<TimePlot::Point>* drained)
+{
+    auto src = slot->derived.get();
+    auto& events = src->events;
+    events.clear();
+
+    // Collect points appended to inputs since last evaluation. Points already evicted from
+    //  an input are skipped.
+    for (size_t i = 0; i < src->inputs.size(); ++i) {
+        auto& input = src->inputs[i]->async;
+        auto& allV = input.allValues;
+        auto& cursor = src->cursors[i];
+
+        auto const seqFront = input.numAppended - allV.size();
+        cursor = max(cursor, seqFront);
+
+        for (auto it = std::next(allV.begin(), cursor - seqFront); it != allV.end(); ++it) {
+            events.emplace_back(*it, i);
+        }
+
+        cursor = input.numAppended;
+    }
+
+    if (events.empty()) { return; }
+
+    std::stable_sort(events.begin(), events.end(),
+                     [](auto& a, auto& b) { return a.first.timestamp < b.first.timestamp; });
+
+    // Inputs are sampled and held; every input point yields an output point at its
+    //  timestamp, evaluated with latest values of other inputs. Stateful operators only
+    //  step on points of inputs they refer.
+    for (auto& [pt, index] : events) {
+        if (std::isnan(pt.value)) { continue; }
+        if (std::isnan(src->latest[index])) { ++src->numReady; }
+        src->latest[index] = pt.value;
+
+        if (src->numReady < src->inputs.size()) { continue; }
+
+        auto value = src->evaluator->Evaluate(pt.timestamp, src->latest.data(), index);
+        if (std::isnan(value)) { continue; }
+
+        drained->push_back({pt.timestamp, value});
+    }
+
+    if (not drained->empty()) {
+        slot->uploadSequence.fetch_add(1);
+        slot->timeLastUpload = steady_clock::now();
+    }
+}
+
+void TimePlotWindowManager::_fnAsyncUpdateStatistics(
+        TimePlot::SlotData* slot, steady_clock::time_point xmin, steady_clock::time_point xmax)
+{
+    auto slotCtx = &slot->async;
+    auto& allV = slotCtx->allValues;
+    auto& stats = slotCtx->stats;
+    auto& [seqBegin, seqEnd] = slotCtx->statsSequence;
+
+    auto sbeg = allV.begin(), send = allV.end();
+    auto vbeg = std::lower_bound(sbeg, send, xmin);
+    auto vend = std::lower_bound(vbeg, send, xmax);
+
+    auto const seqFront = slotCtx->numAppended - allV.size();
+    auto const seqVisibleBegin = seqFront + size_t(std::distance(sbeg, vbeg));
+    auto const seqVisibleEnd = seqFront + size_t(std::distance(sbeg, vend));
+
+    // Slide previous range if it only moved forward, and samples leaving the range are
+    //  still in memory. Otherwise, rebuild from scratch.
+    bool const bSlide = seqBegin >= seqFront
+                        && seqBegin <= seqVisibleBegin && seqVisibleBegin <= seqEnd
+                        && seqEnd <= seqVisibleEnd
+                        && not stats.ShouldRebuild();
+
+    if (bSlide) {
+        for (auto it = std::next(sbeg, seqBegin - seqFront); it != vbeg; ++it) { stats.Remove(it->value); }
+        for (auto it = std::next(sbeg, seqEnd - seqFront); it != vend; ++it) { stats.Add(it->value); }
+    } else {
+        stats.Clear();
+        for (auto it = vbeg; it != vend; ++it) { stats.Add(it->value); }
+    }
+
+    seqBegin = seqVisibleBegin, seqEnd = seqVisibleEnd;
+    slotCtx->statsSummary = stats.Summary();
 }
 
-void TimePlotWindowManager::_fnAsyncValidateCache()
+void TimePlotWindowManager::_fnAsyncBuildSlotCache(TimePlot::SlotData* slot, vector<TimePlot::Point>* pseudo)
 {
     // Perform caching
     // To make auto-fit available, first and last point of data must be contained!
-    auto bx = _async.cacheBuild + 0;
-    auto by = _async.cacheBuild + 1;
-
+    auto slotCtx = &slot->async;
+    auto bx = slotCtx->cacheSegment + 0;
+    auto by = slotCtx->cacheSegment + 1;
     bx->clear(), by->clear();
-    auto now = steady_clock::now();
-    auto sysNow = system_clock::now();
-    auto nowD = now.time_since_epoch();
-    auto sysNowD = sysNow.time_since_epoch();
-    auto tzone = duration_cast<steady_clock::duration>(timezone_offset());
-
-    // Iterate slots, cache plot window frame ranges
-    for (auto& slot : _async.targets) {
-        auto slotCtx = &slot->async;
-        auto const& finfo = slotCtx->frameInfo;
-        auto const bTimeBuild = finfo.bTimeBuildMode;
-        auto& [i1, i2] = slotCtx->cacheAxisRange;
-        i1 = i2 = bx->size();
-
-        // sample / pixel
-        auto numSampleLeftL = size_t(finfo.displayPixelWidth);
-        auto allV = &slotCtx->allValues;
-        auto sbeg = allV->begin(), send = allV->end();
-
-        // Sample within given window range
-        auto [dmin, dmax] = finfo.rangeX;
-        steady_clock::time_point xmin, xmax;
-
-        if (bTimeBuild) {
-            xmin = steady_clock::time_point{} + duration_cast<system_clock::duration>(1.s * dmin) - sysNowD + nowD - tzone;
-            xmax = steady_clock::time_point{} + duration_cast<system_clock::duration>(1.s * dmax) - sysNowD + nowD - tzone;
-        } else {
-            xmin = now + duration_cast<steady_clock::duration>(1.s * dmin);
-            xmax = now + duration_cast<steady_clock::duration>(1.s * dmax);
+
+    auto const& axis = _async.axis;
+    auto const& finfo = slotCtx->frameInfo;
+    auto const bTimeBuild = finfo.bTimeBuildMode;
+
+    // sample / pixel
+    auto numPixels = size_t(finfo.displayPixelWidth);
+    auto allV = &slotCtx->allValues;
+    auto sbeg = allV->begin(), send = allV->end();
+
+    // Sample within given window range
+    auto [dmin, dmax] = finfo.rangeX;
+    auto xmin = axis.FromPlot(dmin, bTimeBuild);
+    auto xmax = axis.FromPlot(dmax, bTimeBuild);
+
+    // Give some margin both side
+    auto margin = (xmax - xmin) / 20;
+    xmin -= margin, xmax += margin;
+
+    if (numPixels == 0) { return; }
+    if (sbeg == send) { return; }
+
+    _fnAsyncUpdateStatistics(slot, xmin + margin, xmax - margin);
+
+    auto const mode = finfo.decimation;
+    auto out = &slotCtx->decimated;
+
+    // Find visible range, including one more point on each side to keep lines connected
+    //  to out-of-range samples.
+    auto vbeg = std::lower_bound(sbeg, send, xmin);
+    auto vend = std::lower_bound(vbeg, send, xmax);
+    if (vbeg != sbeg) { --vbeg; }
+    if (vend != send) { ++vend; }
+
+    // Visible range may extend to history which was spilled out of memory.
+    auto spill = &slotCtx->spill;
+    bool const bIncludeSpill = not spill->Empty() && xmin < sbeg->timestamp;
+
+    // If there are too many samples visible, serve them from coarser level of pyramid.
+    //  Remaining tail that is not summarized yet is filled with raw samples.
+    auto const numVisible = size_t(std::distance(vbeg, vend));
+    auto const level = TimePlot::SamplePyramid::SelectLevel(numVisible, numPixels);
+
+    // Pixel buckets are aligned to clock epoch, thus buckets of previous output stay valid
+    //  while bucket width is kept and the view only moves forward. Then only the last
+    //  bucket, which may have been incomplete, and newer ones need to be re-sampled.
+    //  As LTTB depends on the whole range, it's always rebuilt from scratch.
+    auto width = TimePlot::detail::BucketWidthOf(xmin, xmax, numPixels);
+    auto tailFrom = vbeg->timestamp;
+    auto rbeg = vbeg;
+
+    bool bIncremental = mode != TimePlot::EDecimation::LTTB
+                        && not bIncludeSpill
+                        && not out->points.empty()
+                        && out->mode == mode
+                        && out->numPixels == numPixels
+                        && out->level == level
+                        && xmin >= out->xmin
+                        && out->points.back().timestamp >= vbeg->timestamp
+                        // Tolerate rounding error of window range conversion
+                        && std::abs((width - out->width).count()) * 1000 <= out->width.count();
+
+    if (bIncremental) {
+        width = out->width;
+
+        auto const fnPixelBegin
+                = [width](steady_clock::time_point tp) {
+                      return steady_clock::time_point{width * TimePlot::detail::BucketIndexOf(tp, width)};
+                  };
+
+        tailFrom = fnPixelBegin(out->points.back().timestamp);
+
+        // Coarse bucket straddling the boundary is re-emitted whole, as its extremes may
+        //  have changed; re-sample from the pixel where it begins.
+        while (level > 0) {
+            auto begin = slotCtx->pyramid.BucketBeginAt(level, tailFrom);
+            if (begin >= tailFrom) { break; }
+
+            tailFrom = fnPixelBegin(begin);
         }
 
-        // Give some margin both side
-        auto margin = (xmax - xmin) / 20;
-        xmin -= margin, xmax += margin;
+        rbeg = std::lower_bound(sbeg, vend, tailFrom);
+        bIncremental = rbeg != vend && tailFrom > xmin;
+    }
 
-        if (numSampleLeftL == 0) { continue; }
-        if (sbeg == send) { continue; }
+    auto& points = out->points;
 
-        // Search lower bound from remaining contents
-        for (; sbeg != send && numSampleLeftL; --numSampleLeftL) {
-            // Store cached value
-            by->push_back(sbeg->value);
+    if (bIncremental) {
+        // Drop the last bucket, which will be re-sampled along with new points.
+        points.erase(std::lower_bound(points.begin(), points.end(), tailFrom), points.end());
 
-            if (bTimeBuild)
-                bx->push_back(to_seconds(sbeg->timestamp.time_since_epoch() - nowD + sysNowD + tzone));
-            else
-                bx->push_back(to_seconds(sbeg->timestamp - now));
+        // Drop points scrolled out, except the last one to keep line connected.
+        auto head = std::lower_bound(points.begin(), points.end(), xmin);
+        if (head != points.begin()) { --head; }
+        points.erase(points.begin(), head);
+    } else {
+        points.clear();
+        rbeg = vbeg;
+        tailFrom = steady_clock::time_point::min();
+    }
+
+    out->mode = mode;
+    out->numPixels = numPixels;
+    out->level = level;
+    out->xmin = xmin;
+    out->width = width;
 
-            // Determine next time-point by uniform division
-            xmin = xmin + (xmax - xmin) / numSampleLeftL;
+    // Decimate with exactly the same bucket width as kept above
+    auto const xmaxFixed = xmin + width * int64_t(numPixels);
+    auto const fnPushOut = [&points](TimePlot::Point const& pt) { points.push_back(pt); };
+    auto const fnPushPseudo = [pseudo](TimePlot::Point const& pt) { pseudo->push_back(pt); };
 
-            // Binary search next node.
-            sbeg = std::lower_bound(sbeg + 1, send, xmin);
+    if (bIncludeSpill || level > 0) {
+        pseudo->clear();
+
+        if (bIncludeSpill) {
+            spill->Collect(xmin, sbeg->timestamp, numPixels, mode, fnPushPseudo);
         }
 
-        // Must push last element, to make autofit available.
-        // First element will automatically be added by above loop logic.
-        by->push_back(allV->back().value);
+        auto rawFrom = rbeg->timestamp;
+        if (level > 0) {
+            rawFrom = slotCtx->pyramid.Collect(level, rawFrom, xmax, mode, fnPushPseudo);
+        }
 
-        if (bTimeBuild)
-            bx->push_back(to_seconds(allV->back().timestamp.time_since_epoch() - nowD + sysNowD + tzone));
-        else
-            bx->push_back(to_seconds(allV->back().timestamp - now));
+        pseudo->insert(pseudo->end(), std::lower_bound(rbeg, vend, rawFrom), vend);
+        TimePlot::Decimate(mode, pseudo->begin(), pseudo->end(), xmin, xmaxFixed, numPixels, fnPushOut);
+    } else {
+        TimePlot::Decimate(mode, rbeg, vend, xmin, xmaxFixed, numPixels, fnPushOut);
+    }
 
-        // Correct cache axis range
-        i2 = bx->size();
+    // Convert to plot coordinates. As x axis is relative to current time, this has to be
+    //  done for every point on every build, which is bounded by number of pixels.
+    steady_clock::time_point lastPushed = {};
+    auto const fnPush
+            = [&](TimePlot::Point const& pt) {
+                  lastPushed = pt.timestamp;
+                  bx->push_back(axis.ToPlot(pt.timestamp, bTimeBuild));
+                  by->push_back(pt.value);
+              };
+
+    // To make auto-fit available, first and last point of data must be contained.
+    if (spill->Empty()) {
+        if (vbeg != sbeg) { fnPush(*sbeg); }
+    } else if (spill->Front().timestamp < xmin) {
+        fnPush(spill->Front());
+    }
+
+    for (auto& pt : points) { fnPush(pt); }
+
+    if (bx->empty() || lastPushed != allV->back().timestamp) { fnPush(allV->back()); }
+}
+
+void TimePlotWindowManager::_fnAsyncLookupCrosshair()
+{
+    auto const time = _async.crosshairTime;
+
+    // Samples are sorted by time, thus each slot takes a single binary search.
+    for (auto& slot : _async.crosshairSlots) {
+        auto& allV = slot->async.allValues;
+        auto& out = slot->async.crosshairValue;
+        out = NAN;
+
+        if (allV.empty() || time < allV.front().timestamp) { continue; }
+
+        auto iter = std::lower_bound(allV.begin(), allV.end(), time);
+        if (iter == allV.end()) {
+            // Beyond the latest sample, hold its value.
+            out = allV.back().value;
+        } else if (iter->timestamp == time || iter == allV.begin()) {
+            out = iter->value;
+        } else {
+            auto& [t1, v1] = *std::prev(iter);
+            auto& [t2, v2] = *iter;
+            auto ratio = to_seconds(time - t1) / to_seconds(t2 - t1);
+            out = v1 + (v2 - v1) * ratio;
+        }
+    }
+}
+
+void TimePlotWindowManager::_fnAsyncMergeCache()
+{
+    // Concatenate output segment of every slot plotted on rebuilt windows, including ones
+    //  which were not rebuilt this time.
+    for (auto& wnd : _async.windows) {
+        auto bx = wnd->async.cacheBuild + 0;
+        auto by = wnd->async.cacheBuild + 1;
+        bx->clear(), by->clear();
+
+        for (auto& slot : wnd->async.plotted) {
+            auto slotCtx = &slot->async;
+            auto& [i1, i2] = slotCtx->cacheAxisRange;
+            auto& [sx, sy] = slotCtx->cacheSegment;
+
+            i1 = bx->size();
+            bx->insert(bx->end(), sx.begin(), sx.end());
+            by->insert(by->end(), sy.begin(), sy.end());
+            i2 = bx->size();
+        }
     }
 
     // Request swap buffer on main thread.
@@ -452,17 +1038,61 @@ void TimePlotWindowManager::_fnMainThreadSwapBuffer()
 {
     VerifyMainThread();
     _caching = false;
-    _cacheRecvFrame = true;
 
-    // Swap build/render buffer here.
-    swap(_cacheRender[0], _async.cacheBuild[0]);
-    swap(_cacheRender[1], _async.cacheBuild[1]);
+    for (auto& slot : _async.crosshairSlots) {
+        slot->crosshairValue = slot->async.crosshairValue;
+    }
 
-    // Swap slots ranges ...
-    for (auto& slot : _slots) {
-        slot->cacheAxisRange[0] = slot->async.cacheAxisRange[0];
-        slot->cacheAxisRange[1] = slot->async.cacheAxisRange[1];
+    for (auto& wnd : _async.windows) {
+        wnd->bCacheReceived = true;
+        wnd->async.bRebuild = false;
+        wnd->axis = _async.axis;
+
+        // Swap build/render buffer here.
+        swap(wnd->cacheRender[0], wnd->async.cacheBuild[0]);
+        swap(wnd->cacheRender[1], wnd->async.cacheBuild[1]);
+
+        // Swap slots ranges ...
+        for (auto& slot : wnd->async.plotted) {
+            slot->cacheAxisRange[0] = slot->async.cacheAxisRange[0];
+            slot->cacheAxisRange[1] = slot->async.cacheAxisRange[1];
+            slot->stats = slot->async.statsSummary;
+        }
+
+        if (*GConfig::Widgets::TimePlotGpuRender) {
+            wnd->cacheVertices.resize(wnd->cacheRender[0].size() * 2);
+            wnd->bVerticesDirty = true;
+
+            for (auto& slot : wnd->async.plotted) { _buildSlotVertices(wnd.get(), slot.get()); }
+        }
     }
+
+    _async.windows.clear();
+}
+
+void TimePlotWindowManager::_buildSlotVertices(TimePlot::WindowContext* wnd, TimePlot::SlotData const* slot)
+{
+    auto& [rX, rY] = wnd->cacheRender;
+    auto [i1, i2] = slot->cacheAxisRange;
+    if (i1 == i2 || i2 > rX.size()) { return; }
+
+    // Narrow to float vertices, relative to first x of each slot to keep precision of
+    //  absolute time axis.
+    auto& vertices = wnd->cacheVertices;
+    vertices.resize(rX.size() * 2);
+
+    for (auto i = i1; i < i2; ++i) {
+        vertices[i * 2 + 0] = float(rX[i] - rX[i1]);
+        vertices[i * 2 + 1] = float(rY[i]);
+    }
+
+    wnd->bVerticesDirty = true;
+}
+
+size_t TimePlotWindowManager::_historyBudgetShare(size_t numSlots)
+{
+    auto const total = size_t(max(0, *GConfig::Widgets::TimePlotHistoryBudgetMB)) << 20;
+    return total / std::max<size_t>(numSlots, 1);
 }
 
 void TimePlotWindowManager::_fnTriggerAsyncJob()
@@ -471,6 +1101,18 @@ void TimePlotWindowManager::_fnTriggerAsyncJob()
 
     bool bHasAnyInvalidCache = false;
     _async.targets.clear();
+    _async.windows.clear();
+
+    vector<std::pair<shared_ptr<TimePlot::SlotData>, bool>> derivedTargets;
+
+    for (auto& wnd : _windows) {
+        wnd->async.plotted.clear();
+
+        // Moving frames shift their axis on every cache reception, thus always rebuilt.
+        if (wnd->bIsDisplayed && wnd->frameInfo.bTimeBuildMode == wnd->bFollowGraphMovement) {
+            wnd->bDirty = true;
+        }
+    }
 
     for (auto iter = _slots.begin(); iter != _slots.end();) {
         if ((**iter).bMarkDestroied) {
@@ -480,31 +1122,60 @@ void TimePlotWindowManager::_fnTriggerAsyncJob()
             CPPH_FINALLY(++iter);
 
             bool bCacheInvalid = false;
-            bCacheInvalid |= not slot->pointsPendingUploaded.empty();
+            bCacheInvalid |= not slot->pointsPendingUploaded.Empty();
+
+            // Share of history budget shrinks as slots are added, which is applied on drain.
+            bCacheInvalid |= slot->async.spill.ResidentBytes() > _async.historyBudget;
 
+            // Even if it's not being plotted, uploaded points must be drained.
             auto refWindow = slot->targetWindow.lock();
-            if (not refWindow) { continue; }  // Not being plotted.
+            slot->async.bPlotted = refWindow != nullptr;
 
-            bCacheInvalid |= (bool)refWindow->bDirty;
-            bCacheInvalid |= (bool)slot->bTargetWndChanged;
+            if (refWindow) {
+                refWindow->async.plotted.push_back(slot);
+                bCacheInvalid |= (bool)refWindow->bDirty;
+                bCacheInvalid |= (bool)slot->bTargetWndChanged;
+                slot->bTargetWndChanged = false;
+
+                slot->async.frameInfo = refWindow->frameInfo;
+            }
+
+            // Derived slots are validated after every primary target is determined.
+            if (slot->derived) {
+                derivedTargets.emplace_back(slot, bCacheInvalid);
+                continue;
+            }
 
             if (not bCacheInvalid) { continue; }
             bHasAnyInvalidCache = true;
 
-            auto& async = slot->async;
-            auto& allV = async.allValues;
-            auto& queued = slot->pointsPendingUploaded;
+            _async.targets.push_back(slot);
 
-            size_t constexpr MAX_ENTITY = 2'000'000;
-            if (allV.capacity() - allV.size() < queued.size() && allV.capacity() < MAX_ENTITY) {
-                allV.reserve_shrink(min(MAX_ENTITY, allV.capacity() * 4));
+            if (refWindow && not exchange(refWindow->async.bRebuild, true)) {
+                _async.windows.push_back(refWindow);
             }
+        }
+    }
 
-            async.frameInfo = refWindow->frameInfo;
-            allV.enqueue_n(queued.begin(), queued.size());
+    _async.numPrimaryTargets = _async.targets.size();
 
-            slot->pointsPendingUploaded.clear();
-            _async.targets.push_back(slot);
+    for (auto& [slot, bInvalid] : derivedTargets) {
+        auto src = slot->derived.get();
+
+        for (size_t i = 0; i < src->inputs.size() && not bInvalid; ++i) {
+            auto& input = src->inputs[i];
+            bInvalid |= input->async.numAppended != src->cursors[i];
+            bInvalid |= find(_async.targets.begin(), _async.targets.begin() + _async.numPrimaryTargets, input)
+                        != _async.targets.begin() + _async.numPrimaryTargets;
+        }
+
+        if (not bInvalid) { continue; }
+        bHasAnyInvalidCache = true;
+
+        _async.targets.push_back(slot);
+
+        if (auto refWindow = slot->targetWindow.lock(); refWindow && not exchange(refWindow->async.bRebuild, true)) {
+            _async.windows.push_back(refWindow);
         }
     }
 
@@ -513,10 +1184,222 @@ void TimePlotWindowManager::_fnTriggerAsyncJob()
         wnd->bDirty = false;
     }
 
+    // Values at crosshair are looked up on every job, as new samples may arrive around it.
+    _async.crosshairSlots.clear();
+    bool bCrosshairMoved = false;
+
+    if (_crosshair.bActive) {
+        bCrosshairMoved = _crosshair.time != exchange(_crosshair.timeRequested, _crosshair.time);
+        _async.crosshairTime = _crosshair.time;
+
+        for (auto& wnd : _windows) {
+            if (not wnd->bIsDisplayed) { continue; }
+            auto& plotted = wnd->async.plotted;
+            _async.crosshairSlots.insert(_async.crosshairSlots.end(), plotted.begin(), plotted.end());
+        }
+    }
+
     // Trigger async job
-    if (bHasAnyInvalidCache) {
+    if (bHasAnyInvalidCache || (bCrosshairMoved && not _async.crosshairSlots.empty())) {
         _caching = true;
-        _asyncWorker.post(bind(&TimePlotWindowManager::_fnAsyncValidateCache, this));
+        _prepareAsyncJob();
+
+        _async.targetCursor = 0;
+        _async.bDerivedPhase = false;
+        _postCacheShards(_async.numPrimaryTargets);
+    }
+}
+
+void TimePlotWindowManager::_postCacheShards(size_t numTargets)
+{
+    // At least one shard runs, even if only crosshair lookup is requested.
+    auto numShards = std::clamp<size_t>(numTargets, 1, _async.shardSamples.size());
+    _async.numPendingShards = numShards;
+
+    for (size_t i = 0; i < numShards; ++i) {
+        _asyncWorker->post(bind(&TimePlotWindowManager::_fnAsyncValidateCache, this, i));
+    }
+}
+
+void TimePlotWindowManager::_prepareAsyncJob()
+{
+    // Worker pool is idle here, thus it's safe to replace it.
+    auto numWorkers = size_t(std::clamp(*GConfig::Widgets::TimePlotCacheWorkers, 0, 64));
+    if (numWorkers == 0) { numWorkers = std::max(1u, std::thread::hardware_concurrency()); }
+
+    if (not _asyncWorker || _async.shardSamples.size() != numWorkers) {
+        _asyncWorker.reset();
+        _asyncWorker = make_unique<thread_pool>(numWorkers);
+        _async.shardSamples.resize(numWorkers);
+        _async.shardDrained.resize(numWorkers);
+    }
+
+    _async.bSpillHistory = *GConfig::Widgets::TimePlotSpillHistory;
+    _async.historyBudget = _historyBudgetShare(_slots.size());
+    _async.historyCodec = TimePlot::EValueCodec(std::clamp(
+            *GConfig::Widgets::TimePlotHistoryCodec, 0, int(TimePlot::EValueCodec::_Count) - 1));
+    _async.axis.now = steady_clock::now();
+    _async.axis.sysNow = system_clock::now();
+    _async.axis.timezone = duration_cast<steady_clock::duration>(timezone_offset());
+}
+
+void TimePlotWindowManager::ExportArchive(string path, bool bVisibleOnly)
+{
+    VerifyMainThread();
+
+    auto& job = _archiveJobs.emplace_back();
+    job.path = std::move(path);
+
+    for (auto& slot : _slots) {
+        if (slot->bMarkDestroied) { continue; }
+
+        if (bVisibleOnly) {
+            auto wnd = slot->targetWindow.lock();
+            if (not wnd || not wnd->bIsDisplayed) { continue; }
+        }
+
+        job.slots.push_back(slot);
+    }
+}
+
+void TimePlotWindowManager::ImportArchive(string path)
+{
+    VerifyMainThread();
+
+    auto& job = _archiveJobs.emplace_back();
+    job.path = std::move(path);
+    job.bImport = true;
+}
+
+void TimePlotWindowManager::_fnTriggerArchiveJob()
+{
+    VerifyMainThread();
+
+    // Cache builder is idle here, thus async context of slots can be copied. Cache builds
+    //  go on while the job runs, thus it never refers async context afterwards.
+    _bArchiveRunning = true;
+    _archive = std::move(_archiveJobs.front());
+    _archiveJobs.pop_front();
+
+    auto& job = _archive;
+    job.exported.reserve(job.slots.size());
+
+    for (auto& slot : job.slots) {
+        auto& snapshot = job.exported.emplace_back();
+        auto& plotColor = slot->plotColor;
+
+        snapshot.name = slot->name;
+        snapshot.color[0] = plotColor.x, snapshot.color[1] = plotColor.y;
+        snapshot.color[2] = plotColor.z, snapshot.color[3] = plotColor.w;
+        snapshot.history = slot->async.spill.TakeSnapshot();
+        snapshot.recent.assign(slot->async.allValues.begin(), slot->async.allValues.end());
+    }
+
+    job.slots.clear();
+    job.bSpillHistory = *GConfig::Widgets::TimePlotSpillHistory;
+    job.historyBudget = _historyBudgetShare(_slots.size() + 1);
+    job.historyCodec = TimePlot::EValueCodec(std::clamp(
+            *GConfig::Widgets::TimePlotHistoryCodec, 0, int(TimePlot::EValueCodec::_Count) - 1));
+
+    if (not _archiveWorker) { _archiveWorker = make_unique<thread_pool>(1); }
+    _archiveWorker->post(bind(&TimePlotWindowManager::_fnAsyncRunArchiveJob, this));
+}
+
+void TimePlotWindowManager::_fnAsyncRunArchiveJob()
+{
+    if (_archive.bImport)
+        _fnAsyncImportArchive();
+    else
+        _fnAsyncExportArchive();
+
+    PostEventMainThread(bind(&TimePlotWindowManager::_fnMainThreadFinishArchiveJob, this));
+}
+
+void TimePlotWindowManager::_fnAsyncExportArchive()
+{
+    auto& job = _archive;
+
+    TimePlot::ArchiveWriter writer;
+    if (not writer.Open(job.path, TimePlot::EValueCodec::Xor)) {
+        job.error = fmt::format("failed to open '{}'", job.path);
+        return;
+    }
+
+    // Spilled samples are streamed chunk by chunk, thus memory usage doesn't grow with
+    //  history size.
+    for (auto& slot : job.exported) {
+        auto const fnAppend = [&](TimePlot::Point const& pt) { writer.Append(pt), ++job.numPoints; };
+
+        writer.BeginSlot(slot.name, slot.color);
+        job.numSkipped += slot.history.ForEach(fnAppend);
+        for (auto& pt : slot.recent) { fnAppend(pt); }
+        writer.EndSlot();
+
+        // Release memory as soon as possible
+        slot.history = {};
+        slot.recent = {};
+    }
+
+    if (not writer.Close()) {
+        job.error = fmt::format("failed to write '{}'", job.path);
+    }
+}
+
+void TimePlotWindowManager::_fnAsyncImportArchive()
+{
+    auto& job = _archive;
+
+    TimePlot::ArchiveReader reader;
+    if (not reader.Open(job.path)) {
+        job.error = fmt::format("failed to open '{}' as plot archive", job.path);
+        return;
+    }
+
+    string name;
+    float color[4];
+    vector<TimePlot::Point> points;
+
+    // Chunks are appended as if they were uploaded, thus older ones are spilled as usual.
+    //  Slots are not visible to cache builder until the job finishes.
+    while (reader.NextSlot(&name, color)) {
+        auto slot = job.imported.emplace_back(make_shared<TimePlot::SlotData>());
+        slot->name = name;
+        slot->plotColor = {color[0], color[1], color[2], color[3]};
+        slot->async.spill.Configure(job.historyCodec, job.historyBudget, job.bSpillHistory);
+
+        for (points.clear(); reader.NextChunk(&points); points.clear()) {
+            job.numPoints += points.size();
+            _fnAsyncAppendPoints(slot.get(), &points);
+        }
+    }
+
+    if (reader.Malformed()) {
+        job.error = fmt::format("'{}' is truncated or malformed", job.path);
+    }
+}
+
+void TimePlotWindowManager::_fnMainThreadFinishArchiveJob()
+{
+    VerifyMainThread();
+    _bArchiveRunning = false;
+
+    auto job = std::move(_archive);
+    _archive = {};
+
+    // Imported slots have no proxy, thus nothing can commit to them.
+    _slots.insert(_slots.end(), job.imported.begin(), job.imported.end());
+
+    if (not job.error.empty()) {
+        spdlog::warn("Plot archive: {}", job.error);
+        NotifyToast{LOCWORD("Plot Archive")}.Error().String(job.error);
+    } else if (job.bImport) {
+        NotifyToast{LOCWORD("Plot Archive")}.String("{} slots, {} points imported", job.imported.size(), job.numPoints);
+    } else {
+        NotifyToast{LOCWORD("Plot Archive")}.String("{} slots, {} points exported", job.exported.size(), job.numPoints);
+    }
+
+    if (job.numSkipped > 0) {
+        NotifyToast{LOCWORD("Plot Archive")}.Warning().String("{} points were discarded from history, and skipped", job.numSkipped);
     }
 }
 
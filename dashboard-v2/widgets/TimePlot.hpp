@@ -3,29 +3,28 @@
 //
 
 #pragma once
+#include <atomic>
+#include <cmath>
+#include <deque>
+
 #include "cpph/container/circular_queue.hxx"
 #include "cpph/thread/thread_pool.hxx"
 #include "cpph/utility/timer.hxx"
 #include "imgui.h"
+#include "utils/MpscRing.hpp"
 #include "utils/TimePlotSlotProxy.hpp"
+#include "widgets/timeplot/Decimation.hpp"
+#include "widgets/timeplot/Expression.hpp"
+#include "widgets/timeplot/LineRenderer.hpp"
+#include "widgets/timeplot/Point.hpp"
+#include "widgets/timeplot/Pyramid.hpp"
+#include "widgets/timeplot/SpillStore.hpp"
+#include "widgets/timeplot/Statistics.hpp"
 
 namespace TimePlot {
 using std::chrono::steady_clock;
 class WindowContext;
 
-/**
- * Indicates single dot on plot
- */
-struct Point {
-    steady_clock::time_point timestamp = {};
-    double value = 0;
-
-    bool operator<(steady_clock::time_point const& tp) const noexcept
-    {
-        return timestamp < tp;
-    }
-};
-
 /**
  * A plotting window
  *
@@ -40,6 +39,40 @@ struct WindowFrameDescriptor {
 
     // Use time based build mode
     bool bTimeBuildMode = false;
+
+    // Sample reduction method
+    EDecimation decimation = EDecimation::MinMax;
+};
+
+/**
+ * Maps time to x coordinate of plot, as of a cache build. X is seconds relative to build
+ *  time, or seconds since epoch in local time if time build mode is set.
+ */
+struct TimeAxis {
+    steady_clock::time_point now = {};
+    std::chrono::system_clock::time_point sysNow = {};
+    steady_clock::duration timezone = {};
+
+    double ToPlot(steady_clock::time_point tp, bool bTimeBuild) const noexcept
+    {
+        using seconds = std::chrono::duration<double>;
+
+        if (bTimeBuild)
+            return seconds(tp.time_since_epoch() - now.time_since_epoch() + sysNow.time_since_epoch() + timezone).count();
+        else
+            return seconds(tp - now).count();
+    }
+
+    steady_clock::time_point FromPlot(double x, bool bTimeBuild) const noexcept
+    {
+        using namespace std::chrono;
+        auto offset = duration_cast<steady_clock::duration>(duration<double>(x));
+
+        if (bTimeBuild)
+            return steady_clock::time_point{} + offset - sysNow.time_since_epoch() + now.time_since_epoch() - timezone;
+        else
+            return now + offset;
+    }
 };
 
 /**
@@ -47,8 +80,8 @@ struct WindowFrameDescriptor {
  */
 struct SlotData {
     // Is being destroied?
-    // Will be disposed on next iteration.
-    bool bMarkDestroied : 1;
+    // Will be disposed on next iteration. Read from any committing thread.
+    std::atomic_bool bMarkDestroied{false};
 
     // Target window changed ... should be recached !
     bool bTargetWndChanged : 1;
@@ -62,34 +95,104 @@ struct SlotData {
     // Name of this node
     string name;
 
-    // Index range in _cacheRender
+    // Index range in cacheRender of target window
     size_t cacheAxisRange[2] = {};
 
+    // Statistics of visible samples, as of the last cache build
+    StatsSummary stats;
+
+    // Value at crosshair time, interpolated. NaN if there's no sample around.
+    double crosshairValue = NAN;
+
     // Upload sequence index.
-    size_t uploadSequence = 0;
+    std::atomic_size_t uploadSequence{0};
 
     // Latest upload
-    steady_clock::time_point timeLastUpload;
+    std::atomic<steady_clock::time_point> timeLastUpload{};
+
+    // Number of points discarded since ingestion queue was full.
+    std::atomic_size_t numDroppedPoints{0};
+
+    // Number of points discarded since they were older than latest point of the slot.
+    std::atomic_size_t numLatePoints{0};
+
+    // Points committed from any thread, drained by async cache builder.
+    MpscRing<Point> pointsPendingUploaded{1 << 13};
 
-    vector<Point> pointsPendingUploaded;  // Modify on main thread -> Loop Thread
     weak_ptr<WindowContext> targetWindow;
 
     // Plotting color
     ImVec4 plotColor = {};
 
+    // Set if this slot is derived from other slots, instead of being committed.
+    //  After creation, only accessed by async cache builder, or while it's idle.
+    struct DerivedSource {
+        string expression;
+        unique_ptr<Expression> evaluator;
+
+        // Input slots in order of evaluator inputs, and sequence of next point to consume
+        //  from allValues of each.
+        vector<shared_ptr<SlotData>> inputs;
+        vector<size_t> cursors;
+
+        // Latest value of each input. Evaluation starts once every input has any value.
+        vector<double> latest;
+        size_t numReady = 0;
+
+        // Input points merged in chronological order, with index of its input.
+        vector<std::pair<Point, size_t>> events;
+    };
+
+    unique_ptr<DerivedSource> derived;
+
     struct AsyncContext {
-        // Uploaded from main thread
+        // Drained from pointsPendingUploaded
         circular_queue<Point> allValues{1'000};
 
+        // Number of points ever appended to allValues. Gives absolute sequence of samples.
+        size_t numAppended = 0;
+
+        // Multi-resolution summary of allValues. Updated along with allValues.
+        SamplePyramid pyramid;
+
+        // Points evicted from allValues, compressed.
+        SpillStore spill;
+
         // Target window info
         WindowFrameDescriptor frameInfo;
 
+        // Is this slot being plotted? If not, cache build only drains uploaded points.
+        bool bPlotted = false;
+
         // Will be downloaded on junction
         size_t cacheAxisRange[2] = {};
+
+        // Output of this slot. Concatenated into cacheBuild after every slot is built.
+        vector<double> cacheSegment[2];
+
+        // Statistics of raw samples within visible range, which is kept as absolute
+        //  sequence range [begin, end) to slide it on next build.
+        StreamingStats stats;
+        size_t statsSequence[2] = {};
+        StatsSummary statsSummary;
+
+        // Looked up after cache build, if crosshair is active.
+        double crosshairValue = NAN;
+
+        // Decimated output of previous build, and parameters it was built with. Used to
+        //  re-sample only the newly appended tail while the view follows new points.
+        struct {
+            vector<Point> points;
+            steady_clock::time_point xmin = {};
+            steady_clock::duration width = {};
+            size_t numPixels = 0;
+            int level = -1;
+            EDecimation mode = EDecimation::_Count;
+        } decimated;
     } async;
 
    public:
-    SlotData() noexcept : bMarkDestroied(false) {}
+    SlotData() noexcept : bTargetWndChanged(false), bFocusRequested(false), bDisableUserRemove(false) {}
 };
 
 struct WindowContext {
@@ -116,6 +219,37 @@ struct WindowContext {
 
     // Request focus on next frame
     bool bRequestFocus : 1;
+
+    // Cache of this window has been swapped in this frame
+    bool bCacheReceived : 1;
+
+    // Vertices should be uploaded to lineRenderer
+    bool bVerticesDirty : 1;
+
+    // Cache of slots plotted on this window. Only rebuilt when any of them is invalidated,
+    //  thus idle windows are left alone while others are being panned.
+    vector<double> cacheRender[2];
+
+    // GPU rendering path. Vertices are relative to first x of each slot's range.
+    vector<float> cacheVertices;
+    LineRenderer lineRenderer;
+
+    // Time since last cache reception. Used to move frame along with plot.
+    stopwatch tmCacheDelta;
+
+    // Time axis which cacheRender was built with. Used to map cursor position to time.
+    TimeAxis axis;
+
+    struct AsyncContext {
+        // Slots being plotted on this window
+        vector<shared_ptr<SlotData>> plotted;
+
+        // Cache that is being built. Exchanged on thread junction.
+        vector<double> cacheBuild[2];
+
+        // Any slot of this window is invalidated in current job.
+        bool bRebuild = false;
+    } async;
 };
 
 }  // namespace TimePlot
@@ -126,14 +260,55 @@ struct WindowContext {
  */
 class TimePlotWindowManager
 {
+    // Maximum number of raw points retained per slot. Older points are compressed into
+    //  history store of each slot.
+    static constexpr size_t MAX_ENTITY = 1 << 18;
+
     // All slot instances
     vector<shared_ptr<TimePlot::SlotData>> _slots;
 
-    // To not reinitialize the whole array every time ...
-    vector<double> _cacheRender[2];
-
-    // Async work thread
-    thread_pool _asyncWorker{1};
+    // Async work threads. Recreated when configured number of workers changes.
+    unique_ptr<thread_pool> _asyncWorker;
+
+    // Export or import request. Runs on its own worker alongside cache builds; export reads
+    //  snapshots taken while cache builder is idle, and import fills slots which are not
+    //  registered yet.
+    struct ArchiveJob {
+        string path;
+        bool bImport = false;
+
+        // Slots to export
+        vector<shared_ptr<TimePlot::SlotData>> slots;
+
+        // Copied from slots on main thread, as the job starts.
+        struct SlotSnapshot {
+            string name;
+            float color[4] = {};
+            TimePlot::SpillStore::Snapshot history;
+            vector<TimePlot::Point> recent;
+        };
+
+        vector<SlotSnapshot> exported;
+
+        // Config snapshot, for imported slots
+        bool bSpillHistory = true;
+        TimePlot::EValueCodec historyCodec = TimePlot::EValueCodec::Xor;
+        size_t historyBudget = 0;
+
+        // Result
+        vector<shared_ptr<TimePlot::SlotData>> imported;
+        size_t numPoints = 0;
+        size_t numSkipped = 0;
+        string error;
+    };
+
+    std::deque<ArchiveJob> _archiveJobs;
+
+    // Archive job being run, and its worker. Only accessed from archive worker while
+    //  running.
+    unique_ptr<thread_pool> _archiveWorker;
+    ArchiveJob _archive;
+    bool _bArchiveRunning = false;
 
     // Async cache context
     // Only accessible from async thread
@@ -141,41 +316,124 @@ class TimePlotWindowManager
         // List of cache targets
         vector<shared_ptr<TimePlot::SlotData>> targets;
 
-        // Cache that is being built.
-        // Exchanged on thread junction, and may not access from main thread after.
-        vector<double> cacheBuild[2];
+        // Windows which have any invalidated slot. Only these are merged and swapped.
+        vector<shared_ptr<TimePlot::WindowContext>> windows;
+
+        // Pseudo samples expanded from pyramid, per shard.
+        vector<vector<TimePlot::Point>> shardSamples;
+
+        // Points drained from upload queue, per shard.
+        vector<vector<TimePlot::Point>> shardDrained;
+
+        // Index of next target to build, and number of shards still running.
+        std::atomic_size_t targetCursor{0};
+        std::atomic_size_t numPendingShards{0};
+
+        // Targets are ordered as [primary slots..., derived slots...]. Derived slots read
+        //  allValues of their inputs, thus they're built in second phase, which is started
+        //  by the last shard of first phase.
+        size_t numPrimaryTargets = 0;
+        bool bDerivedPhase = false;
+
+        // Time snapshot, shared by all slots of a build.
+        TimePlot::TimeAxis axis;
+
+        // Slots on displayed windows, whose values at crosshairTime are looked up after
+        //  cache build. Empty if crosshair is not active.
+        vector<shared_ptr<TimePlot::SlotData>> crosshairSlots;
+        steady_clock::time_point crosshairTime;
+
+        // Config snapshot
+        bool bSpillHistory = true;
+        TimePlot::EValueCodec historyCodec = TimePlot::EValueCodec::Xor;
+        size_t historyBudget = 0;  // Per slot share of TimePlotHistoryBudgetMB
     } _async;
 
     // Timer for cache revalidation, and a flag to prevent duplicated request.
     bool _caching = false;
-    bool _cacheRecvFrame = false;
     poll_timer _timerCacheTrig = {100ms};
 
+    // GPU render option as of last frame, to build vertices as it's turned on.
+    bool _bGpuRender = false;
+
+    // Time under mouse cursor, shared by every plot window.
+    struct CrosshairContext {
+        bool bActive = false;
+        steady_clock::time_point time = {};
+
+        // Time which values of slots were requested at.
+        steady_clock::time_point timeRequested = {};
+    } _crosshair;
+
     // Widget context
     struct WidgetContext {
         // Show main panel ?
         bool bShowListPanel = false;
+
+        // Input of new derived slot
+        string derivedName;
+        string derivedExpression;
+
+        // Path of archive to export or import
+        string archivePath = "timeplot.pkplot";
     } _widget;
 
     // List of window contexts
     vector<shared_ptr<TimePlot::WindowContext>> _windows;
     size_t _wndCreateIndexer = 0;
 
-    // Time plot delta timer
-    stopwatch _tmTimeplotDelta;
-
    public:
     TimePlotWindowManager();
+    ~TimePlotWindowManager();
     void TickWindow();
     auto CreateSlot(string name) -> TimePlotSlotProxy;
 
+    /**
+     * Creates a slot which is evaluated from other slots by given expression. See
+     *  TimePlot::Expression for syntax.
+     *
+     * @return false if expression is malformed, or refers unknown slot.
+     */
+    bool CreateDerivedSlot(string name, string_view expression, string* error);
+
+    /**
+     * Writes samples of slots to an archive file on async worker. Result is notified.
+     *
+     * @param bVisibleOnly Export only slots plotted on displayed windows.
+     */
+    void ExportArchive(string path, bool bVisibleOnly);
+
+    /**
+     * Reads slots from an archive file on async worker, and adds them as read-only slots.
+     */
+    void ImportArchive(string path);
+
     // Must be inside of
-    void DrawPlotContent(TimePlot::SlotData*);
+    void DrawPlotContent(TimePlot::WindowContext*, TimePlot::SlotData*);
 
    private:
     void _fnTriggerAsyncJob();
-    void _fnAsyncValidateCache();
+    void _fnTriggerArchiveJob();
+    void _prepareAsyncJob();
+    static size_t _historyBudgetShare(size_t numSlots);
+    void _postCacheShards(size_t numTargets);
+    void _fnAsyncValidateCache(size_t shardIndex);
+    void _fnAsyncBuildSlotCache(TimePlot::SlotData* slot, vector<TimePlot::Point>* pseudo);
+    void _fnAsyncDrainUploads(TimePlot::SlotData* slot, vector<TimePlot::Point>* drained);
+    void _fnAsyncAppendPoints(TimePlot::SlotData* slot, vector<TimePlot::Point>* points);
+    void _fnAsyncEvaluateDerived(TimePlot::SlotData* slot, vector<TimePlot::Point>* drained);
+    void _fnAsyncUpdateStatistics(TimePlot::SlotData* slot, steady_clock::time_point xmin, steady_clock::time_point xmax);
+    void _fnAsyncLookupCrosshair();
+    void _fnAsyncMergeCache();
     void _fnMainThreadSwapBuffer();
+    void _buildSlotVertices(TimePlot::WindowContext* wnd, TimePlot::SlotData const* slot);
+    void _fnAsyncRunArchiveJob();
+    void _fnAsyncExportArchive();
+    void _fnAsyncImportArchive();
+    void _fnMainThreadFinishArchiveJob();
+
+    void _drawStatisticsTooltip(TimePlot::SlotData* slot);
+    bool _drawCrosshair(TimePlot::WindowContext* wnd, bool bShowValues);
 
    private:
     auto _createNewPlotWindow(string uniqueId = {}) -> shared_ptr<TimePlot::WindowContext>;
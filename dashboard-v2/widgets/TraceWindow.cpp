@@ -4,6 +4,8 @@
 
 #include "TraceWindow.hpp"
 
+#include <random>
+
 #include "cpph/helper/macros.hxx"
 #include "cpph/refl/object.hxx"
 #include "cpph/refl/rpc/rpc.hxx"
@@ -13,8 +15,51 @@
 #include "imgui.h"
 #include "imgui_extension.h"
 #include "imgui_internal.h"
+#include "perfkit/configs.h"
 #include "spdlog/spdlog.h"
 
+PERFKIT_DECLARE_SUBCATEGORY(GConfig::Widgets)
+{
+    // Directory to write trace recordings to. If empty, recordings are written to a
+    //  temporary directory, which is removed along with the trace window.
+    PERFKIT_CONFIGURE(TraceRecordDirectory, string{}).confirm();
+}
+
+// Snapshots taken from every trace window, thus ones from different sessions can be compared.
+static auto SnapshotRegistry()
+{
+    static vector<shared_ptr<Trace::Snapshot const>> _storage;
+    return &_storage;
+}
+
+static constexpr int NUM_STATS_COLUMNS = 6;
+static constexpr char const* STATS_COLUMN_LABELS[NUM_STATS_COLUMNS] = {"min", "mean", "max", "p50", "p90", "p99"};
+
+// Statistics columns are aligned from right edge, leaving space for value and sparkline.
+static float StatsColumnRight(int column)
+{
+    auto const columnWidth = 64 * DpiScale();
+    auto const valueWidth = 190 * DpiScale();
+
+    return ImGui::GetContentRegionMax().x - valueWidth - float(NUM_STATS_COLUMNS - 1 - column) * columnWidth;
+}
+
+widgets::TraceWindow::~TraceWindow()
+{
+    if (_recordTempDir.empty()) { return; }
+
+    // Files are closed first, as open files can't be removed on some platforms.
+    {
+        std::lock_guard _{_recordLock};
+        _recorders.clear();
+    }
+
+    for (auto& tracer : _tracers) { tracer._replay.reset(); }
+
+    std::error_code ec;
+    std::filesystem::remove_all(_recordTempDir, ec);
+}
+
 void widgets::TraceWindow::BuildService(rpc::service_builder& s)
 {
     using proto::notify;
@@ -31,6 +76,39 @@ void widgets::TraceWindow::Render()
     ImGui::TextUnformatted(KEYTEXT(Trace, "Trace"));
     ImGui::Separator();
 
+    /// Draw filter. ESCAPE clears filter buffer.
+    {
+        bool bFilterChanged = false;
+
+        ImGui::Checkbox("Stats", &_bShowStats);
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("Show statistics over last %u fences. Durations are in ms.",
+                              Trace::SlidingWindowStats::LENGTH);
+        }
+
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(-1);
+        if (ImGui::InputTextWithHint("##Filter", "Filter", _filterBuf, sizeof _filterBuf)) {
+            bFilterChanged = true;
+        }
+
+        if (ImGui::IsItemDeactivated() && ImGui::IsKeyPressed(ImGuiKey_Escape, false)) {
+            _filterBuf[0] = 0;
+            bFilterChanged = true;
+        }
+
+        if (bFilterChanged) {
+            _filter = _filterBuf;
+            for (auto& ch : _filter) { ch = char(tolower((unsigned char)ch)); }
+            for (auto& tracer : _tracers) { tracer._bFilterDirty = true; }
+        }
+    }
+
+    /// Draw snapshot comparison
+    if (not SnapshotRegistry()->empty()) {
+        _drawSnapshotDiff();
+    }
+
     /// Render all tracer roots recursively
     _cachedTpNow = steady_clock::now();
 
@@ -95,6 +173,30 @@ void widgets::TraceWindow::Render()
 
             ImGui::SameLine();
             ImGui::TextColored({.6, .6, .6, .8}, "[ %llu ]", tracer.fence);
+
+            ImGui::SameLine();
+            if (ImGui::Checkbox("Flame", &tracer.bShowFlame) && not tracer.bShowFlame) {
+                tracer._flameFrames.clear();
+                tracer._flameShown.reset();
+                tracer._flameFence = 0;
+            }
+
+            ImGui::SameLine();
+            if (ImGui::SmallButton("Snapshot")) {
+                _takeSnapshot(&tracer);
+            }
+
+            ImGui::SameLine();
+            if (bool bRecording = tracer.bRecording; ImGui::Checkbox("Record", &bRecording)) {
+                _setRecording(&tracer, bRecording);
+            }
+
+            if (not tracer.recordPath.empty()) {
+                ImGui::SameLine();
+                if (bool bReplaying = tracer._replay != nullptr; ImGui::Checkbox("Replay", &bReplaying)) {
+                    _setReplaying(&tracer, bReplaying);
+                }
+            }
         }
 
         /// Draw interval control
@@ -104,18 +206,57 @@ void widgets::TraceWindow::Render()
         if (ImGui::IsPopupOpen("CONF") && ImGui::BeginPopup("CONF")) {
             CPPH_FINALLY(ImGui::EndPopup());
 
-            auto requestIntervalMs = float(tracer.tmNextPublish.interval_sec().count() * 1e3);
+            auto requestIntervalMs = float(to_seconds(tracer.pollInterval) * 1e3);
             if (ImGui::SliderFloat("Intervals", &requestIntervalMs, 1, 1000, "%6.0f ms")) {
-                tracer.tmNextPublish.reset(requestIntervalMs * 1.ms);
+                tracer.pollInterval = std::chrono::duration_cast<steady_clock::duration>(requestIntervalMs * 1.ms);
+                tracer._nextPollAt = {};
+            }
+
+            ImGui::TextDisabled("Backoff x%.1f, round trip %.1f ms",
+                                tracer._pollBackoff, to_seconds(tracer._roundTrip) * 1e3);
+        }
+
+        if (tracer._replay) {
+            _drawReplayControl(&tracer);
+        }
+
+        if (tracer.bShowFlame) {
+            _drawFlameGraph(&tracer);
+        }
+
+        if (tracer._bFilterDirty) {
+            tracer._bFilterDirty = false;
+            _applyFilter(&tracer);
+        }
+
+        if (tracer._bRowsDirty) {
+            tracer._bRowsDirty = false;
+            _rebuildTraceRows(&tracer);
+        }
+
+        // Column labels of statistics
+        if (_bShowStats) {
+            for (int i = 0; i < NUM_STATS_COLUMNS; ++i) {
+                auto width = ImGui::CalcTextSize(STATS_COLUMN_LABELS[i]).x;
+                if (i > 0) { ImGui::SameLine(); }
+
+                ImGui::SetCursorPosX(StatsColumnRight(i) - width);
+                ImGui::TextDisabled("%s", STATS_COLUMN_LABELS[i]);
             }
         }
 
-        for (auto idx : tracer.rootNodeIndices) {
-            auto root = tracer.nodes[idx].get();
+        // Only visible rows are submitted. Row height is measured from the first row.
+        ImGuiListClipper clipper;
+        clipper.Begin(int(tracer._rows.size()));
+
+        while (clipper.Step()) {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+                auto& row = tracer._rows[i];
 
-            ImGui::PushID(root);
-            _recurseRootTraceNode(&tracer, root);
-            ImGui::PopID();
+                ImGui::PushID(row.nodeIndex);
+                _drawTraceNodeRow(&tracer, row.nodeIndex, row.depth);
+                ImGui::PopID();
+            }
         }
     }
 
@@ -125,28 +266,132 @@ void widgets::TraceWindow::Render()
 void widgets::TraceWindow::Tick()
 {
     if (_host->SessionAnchor().expired()) {
+        if (not _tracers.empty()) {
+            std::scoped_lock _{_plotSinkLock, _stagingLock, _recordLock, _statsLock};
+            _plotSinks.clear();
+            _staging.clear();
+            _recorders.clear();
+            _stats.clear();
+        }
+
         _tracers.clear();
+        _tracerIndices.clear();
         return;
     }
 
+    /// Apply updates received since last tick
+    _applyStagedUpdates();
+    _applyStatsUpdates();
+
     /// Publish subscribe request periodically.
     // This operation is performed regardless of window visibility.
+    _publishUpdateRequests();
+}
+
+void widgets::TraceWindow::_publishUpdateRequests()
+{
+    auto const now = steady_clock::now();
+
+    // Tracers whose fence is advancing share the budget below. Idle ones are polled
+    //  rarely under backoff and often left unanswered as nothing changed, thus they are
+    //  bounded only by the hard cap, and can't hold the budget of active ones.
+    auto const fnIsActive = [](TracerContext const& tracer) { return tracer._pollBackoff <= 1; };
+    size_t numInFlight = 0;
+    size_t numActiveInFlight = 0;
+
+    // Each polled tracer keeps round trip / interval requests in flight on average, or a
+    //  whole one until its round trip is measured.
+    double demand = 0;
+
     for (auto& tracer : _tracers) {
-        if (tracer.bIsTracingCached && tracer.tmNextPublish.check_sparse() && tracer._waitExpiry < _cachedTpNow) {
-            tracer._waitExpiry = steady_clock::now() + 5s;
-            proto::service::trace_request_update(_host->RpcSession()).notify(tracer.info.tracer_id);
+        if (tracer.bIsTracingCached) {
+            auto interval = to_seconds(_pollIntervalOf(&tracer));
+            demand += tracer._roundTrip == steady_clock::duration{} ? 1. : to_seconds(tracer._roundTrip) / interval;
         }
+
+        if (tracer._waitExpiry == steady_clock::time_point{}) { continue; }
+
+        if (tracer._waitExpiry < now) {
+            // Response is lost, or tracer has nothing to report; regard it as idle.
+            tracer._waitExpiry = {};
+            _schedulePoll(&tracer, false);
+        } else {
+            ++numInFlight;
+            numActiveInFlight += fnIsActive(tracer);
+        }
+    }
+
+    auto const numTracers = _tracers.size();
+    if (numTracers == 0) { return; }
+
+    // Average demand leaves no room for jitter of round trips, and requests are sent only
+    //  once per frame, thus give twice of it plus one.
+    auto const maxActiveInFlight = std::clamp<size_t>(size_t(std::ceil(demand * 2)) + 1, 1, MAX_IN_FLIGHT_REQUESTS);
+
+    for (size_t i = 0; i < numTracers && numInFlight < MAX_IN_FLIGHT_REQUESTS; ++i) {
+        auto& tracer = _tracers[(_pollCursor + i) % numTracers];
+
+        if (not tracer.bIsTracingCached) { continue; }
+        if (tracer._waitExpiry != steady_clock::time_point{}) { continue; }
+        if (now < tracer._nextPollAt) { continue; }
+
+        bool const bActive = fnIsActive(tracer);
+        if (bActive && numActiveInFlight >= maxActiveInFlight) { continue; }
+
+        // Wait a few round trips before giving up the request. Before any round trip is
+        //  measured, fall back to conservative timeout.
+        auto timeout = tracer._roundTrip == steady_clock::duration{}
+                             ? steady_clock::duration{5s}
+                             : std::clamp<steady_clock::duration>(tracer._roundTrip * 4, 250ms, 5s);
+
+        tracer._requestSentAt = now;
+        tracer._waitExpiry = now + timeout;
+        ++numInFlight;
+        numActiveInFlight += bActive;
+
+        proto::service::trace_request_update(_host->RpcSession()).notify(tracer.info.tracer_id);
     }
+
+    _pollCursor = (_pollCursor + 1) % numTracers;
+}
+
+void widgets::TraceWindow::_schedulePoll(TracerContext* tracer, bool bFenceAdvanced)
+{
+    auto const now = steady_clock::now();
+
+    if (tracer->_waitExpiry != steady_clock::time_point{}) {
+        auto roundTrip = now - tracer->_requestSentAt;
+        tracer->_roundTrip = tracer->_roundTrip == steady_clock::duration{}
+                                   ? roundTrip
+                                   : (tracer->_roundTrip * 7 + roundTrip) / 8;
+        tracer->_waitExpiry = {};
+    }
+
+    // Active tracers are polled at configured rate immediately, while idle ones back off
+    //  gradually, up to 2 seconds unless configured interval is longer.
+    if (bFenceAdvanced)
+        tracer->_pollBackoff = 1;
+    else
+        tracer->_pollBackoff = std::min(MAX_POLL_BACKOFF, tracer->_pollBackoff * 1.5f);
+
+    tracer->_nextPollAt = now + _pollIntervalOf(tracer);
+}
+
+auto widgets::TraceWindow::_pollIntervalOf(TracerContext const* tracer) -> steady_clock::duration
+{
+    auto interval = std::chrono::duration_cast<steady_clock::duration>(tracer->pollInterval * tracer->_pollBackoff);
+    return std::max(tracer->pollInterval, std::min<steady_clock::duration>(interval, 2s));
 }
 
 void widgets::TraceWindow::_fnOnNewTracer(proto::tracer_descriptor_t& trc)
 {
     PostEventMainThreadWeak(
-            _host->SessionAnchor(), [this, trc = trc]() mutable {
-                // If same ID-ed tracer has republished, delete existing local context
-                if (auto idx = _findTracerIndex(trc.tracer_id); ~size_t{} != idx)
-                    if (_tracers[idx].info.tracer_id == trc.tracer_id)
-                        return;
+            _host->SessionAnchor(), [this, trc = move(trc)]() mutable {
+                // If same ID-ed tracer has republished, keep existing local context
+                if (_tracerIndices.count(trc.tracer_id))
+                    return;
+
+                _tracerIndices[trc.tracer_id] = _tracers.size();
 
                 auto* newCtx = &_tracers.emplace_back();
                 newCtx->info = move(trc);
@@ -160,17 +405,35 @@ void widgets::TraceWindow::_fnOnValidateTracer(vector<uint64_t>& aliveTracers)
     PostEventMainThreadWeak(
             _host->SessionAnchor(), [this, aliveTracers = std::move(aliveTracers)]() mutable {
                 erase_if_each(_tracers, [&](TracerContext& t) {
-                    return not binary_search(aliveTracers, t.info.tracer_id);
+                    if (binary_search(aliveTracers, t.info.tracer_id))
+                        return false;
+
+                    _erasePlotSinks(t.info.tracer_id);
+
+                    std::scoped_lock _{_recordLock, _statsLock};
+                    _recorders.erase(t.info.tracer_id);
+                    _stats.erase(t.info.tracer_id);
+                    return true;
                 });
+
+                _rebuildTracerIndices();
             });
 }
 
 size_t widgets::TraceWindow::_findTracerIndex(uint64_t id) const
 {
-    auto iter = find_if(_tracers, [id](auto&& e) { return e.info.tracer_id == id; });
-    if (iter == _tracers.end()) { return ~size_t{}; }
+    auto iter = _tracerIndices.find(id);
+    if (iter == _tracerIndices.end()) { return ~size_t{}; }
 
-    return distance(_tracers.begin(), iter);
+    return iter->second;
+}
+
+void widgets::TraceWindow::_rebuildTracerIndices()
+{
+    _tracerIndices.clear();
+
+    for (size_t i = 0; i < _tracers.size(); ++i)
+        _tracerIndices[_tracers[i].info.tracer_id] = i;
 }
 
 void widgets::TraceWindow::_fnOnNewTraceNode(uint64_t tracer_id, vector<proto::trace_info_t>& nodes)
@@ -180,44 +443,219 @@ void widgets::TraceWindow::_fnOnNewTraceNode(uint64_t tracer_id, vector<proto::t
 
     // Send message
     PostEventMainThreadWeak(
-            _host->SessionAnchor(), [this, tracer_id, nodes] {
+            _host->SessionAnchor(), [this, tracer_id, nodes = move(nodes)] {
                 if (auto tracer = _findTracer(tracer_id)) {
-                    auto curNodes = &tracer->nodes;
+                    auto store = &tracer->nodes;
 
                     // Reserve space
-                    if (auto maxIdx = nodes.back().index; curNodes->size() <= maxIdx) {
-                        curNodes->resize(maxIdx + 1);
+                    if (auto maxIdx = nodes.back().index; store->Size() <= maxIdx) {
+                        store->Resize(maxIdx + 1);
                     }
 
+                    tracer->_bRowsDirty = true;
+                    tracer->_bFilterDirty = not _filter.empty();
+
                     for (auto& newNode : nodes) {
                         // Create new node
-                        auto& curNode = curNodes->at(newNode.index);
-                        if (curNode != nullptr) { continue; }
+                        auto index = newNode.index;
+                        if (store->Exists(index)) { continue; }
 
-                        curNode = make_unique<TraceNodeContext>();
-                        curNode->info = newNode;
+                        store->flags[index] = TraceNode_Exists;
+                        store->parents[index] = newNode.parent_index;
+                        store->nameIds[index] = _internName(newNode.name);
+                        tracer->nameIndex.Add(index, newNode.parent_index, newNode.name);
 
                         if (newNode.parent_index == -1) {
                             // Add to root if it has no parent
-                            tracer->rootNodeIndices.push_back(newNode.index);
+                            tracer->rootNodeIndices.push_back(index);
                         } else {
                             // Otherwise, erase from list ... mostly below operation is pointless.
-                            auto rIter = remove(tracer->rootNodeIndices, newNode.index);
+                            auto rIter = remove(tracer->rootNodeIndices, index);
                             tracer->rootNodeIndices.erase(rIter, tracer->rootNodeIndices.end());
-
-                            // Register as child to parent
-                            auto& parent = curNodes->at(newNode.parent_index);
-                            auto uIter = lower_bound(parent->children, newNode.index);
-
-                            // Unique add ...
-                            if (uIter == parent->children.end() || *uIter != newNode.index)
-                                parent->children.insert(uIter, newNode.index);
                         }
                     }
+
+                    store->RebuildChildren();
                 }
             });
 }
 
+uint32_t widgets::TraceWindow::_internName(string const& name)
+{
+    auto [iter, bIsNew] = _nameIds.try_emplace(name, uint32_t(_names.size()));
+    if (bIsNew) { _names.push_back(name); }
+
+    return iter->second;
+}
+
+void widgets::TraceWindow::TraceNodeStore::Resize(size_t size)
+{
+    parents.resize(size, -1);
+    nameIds.resize(size);
+    fences.resize(size);
+    payloads.resize(size);
+    flags.resize(size);
+    stats.resize(size);
+    historySlots.resize(size, -1);
+    childOffsets.resize(size + 1, uint32_t(childBuffer.size()));
+}
+
+void widgets::TraceWindow::TraceNodeStore::RebuildChildren()
+{
+    auto const n = Size();
+
+    // Count children of each parent, then place them in index order.
+    std::fill(childOffsets.begin(), childOffsets.end(), 0);
+    for (size_t i = 0; i < n; ++i)
+        if (Exists(i) && Exists(parents[i]))
+            ++childOffsets[parents[i] + 1];
+
+    for (size_t i = 0; i < n; ++i)
+        childOffsets[i + 1] += childOffsets[i];
+
+    childBuffer.resize(childOffsets[n]);
+    vector<uint32_t> cursors(childOffsets.begin(), childOffsets.end() - 1);
+
+    for (size_t i = 0; i < n; ++i)
+        if (Exists(i) && Exists(parents[i]))
+            childBuffer[cursors[parents[i]]++] = int(i);
+}
+
+// Key of a gram of 1 to 3 characters. Length is kept in the top byte, thus grams of
+//  different length never collide.
+static uint32_t NameGram(char const* p, size_t length)
+{
+    uint32_t key = uint32_t(length) << 24;
+    for (size_t i = 0; i < length; ++i) { key |= uint32_t(uint8_t(p[i])) << (i * 8); }
+
+    return key;
+}
+
+void widgets::TraceWindow::TraceNameIndex::Add(int index, int parent, string_view name)
+{
+    if (paths.size() <= size_t(index)) {
+        paths.resize(index + 1);
+        nameOffsets.resize(index + 1);
+    }
+
+    auto& path = paths[index];
+    path.clear();
+
+    if (parent >= 0 && size_t(parent) < paths.size() && not paths[parent].empty()) {
+        path = paths[parent];
+        path += '.';
+    }
+
+    nameOffsets[index] = uint32_t(path.size());
+    for (auto ch : name) { path += char(tolower((unsigned char)ch)); }
+
+    // Unigrams and bigrams are indexed as well, thus short queries don't scan every path.
+    //  Nodes mostly arrive in index order, thus insertion is usually an append.
+    for (size_t length = 1; length <= 3; ++length) {
+        for (size_t i = 0; i + length <= path.size(); ++i) {
+            auto& posting = postings[NameGram(path.data() + i, length)];
+            auto pos = std::lower_bound(posting.begin(), posting.end(), index);
+
+            if (pos == posting.end() || *pos != index)
+                posting.insert(pos, index);
+        }
+    }
+}
+
+void widgets::TraceWindow::TraceNameIndex::Query(string_view query, vector<int>* out) const
+{
+    out->clear();
+    if (query.empty()) { return; }
+
+    auto const fnVerify
+            = [&](int index) {
+                  auto pos = paths[index].rfind(query);
+                  return pos != string::npos && pos + query.size() > nameOffsets[index];
+              };
+
+    // Verify nodes of the rarest gram of query only.
+    auto const length = std::min<size_t>(query.size(), 3);
+    vector<int> const* candidates = nullptr;
+
+    for (size_t i = 0; i + length <= query.size(); ++i) {
+        auto iter = postings.find(NameGram(query.data() + i, length));
+        if (iter == postings.end()) { return; }
+
+        if (candidates == nullptr || iter->second.size() < candidates->size())
+            candidates = &iter->second;
+    }
+
+    for (auto index : *candidates)
+        if (fnVerify(index)) { out->push_back(index); }
+}
+
+void widgets::TraceWindow::_applyFilter(TracerContext* tracer)
+{
+    auto& store = tracer->nodes;
+    tracer->_bRowsDirty = true;
+
+    // Only nodes flagged by previous filter are cleared, thus cost is bound to matches.
+    for (auto index : tracer->_filterMarked)
+        store.Set(index, TraceNode_FilterMatch | TraceNode_FilterPath, false);
+
+    tracer->_filterMarked.clear();
+    if (_filter.empty()) { return; }
+
+    tracer->nameIndex.Query(_filter, &_reusedIndices);
+
+    for (auto index : _reusedIndices) {
+        if (not store.Exists(index)) { continue; }
+
+        store.Set(index, TraceNode_FilterMatch, true);
+        tracer->_filterMarked.push_back(index);
+
+        // Stop at the first ancestor already marked by another match.
+        for (auto cursor = store.parents[index]; cursor != -1 && store.Exists(cursor); cursor = store.parents[cursor]) {
+            if (store.Test(cursor, TraceNode_FilterPath)) { break; }
+
+            store.Set(cursor, TraceNode_FilterPath, true);
+            tracer->_filterMarked.push_back(cursor);
+        }
+    }
+}
+
+void widgets::TraceWindow::TraceNodeStore::PushHistory(int index, float value)
+{
+    auto& slot = historySlots[index];
+
+    if (slot < 0) {
+        if (historyFreeSlots.empty()) {
+            auto const first = int(historyCounts.size());
+            historyCounts.resize(first + HISTORY_BLOCK);
+            historyPool.resize(historyCounts.size() * HISTORY_LENGTH);
+
+            for (int i = int(HISTORY_BLOCK) - 1; i >= 0; --i)
+                historyFreeSlots.push_back(first + i);
+        }
+
+        slot = historyFreeSlots.back();
+        historyFreeSlots.pop_back();
+        historyCounts[slot] = 0;
+    }
+
+    auto& count = historyCounts[slot];
+    historyPool[slot * HISTORY_LENGTH + count++ % HISTORY_LENGTH] = value;
+}
+
+void widgets::TraceWindow::TraceNodeStore::ReleaseHistory(int index)
+{
+    if (auto slot = exchange(historySlots[index], -1); slot >= 0)
+        historyFreeSlots.push_back(slot);
+}
+
+auto widgets::TraceWindow::TraceNodeStore::History(int index) const noexcept -> pair<float const*, uint32_t>
+{
+    auto slot = historySlots[index];
+    if (slot < 0) { return {nullptr, 0}; }
+
+    return {historyPool.data() + slot * HISTORY_LENGTH, historyCounts[slot]};
+}
+
 auto widgets::TraceWindow::_findTracer(uint64_t id) -> widgets::TraceWindow::TracerContext*
 {
     auto idx = _findTracerIndex(id);
@@ -266,28 +704,131 @@ static ImU32 VisitPayloadEntity(string* out, bool const& value)
     return ColorRefs::GlyphKeyword;
 }
 
-void widgets::TraceWindow::_recurseRootTraceNode(
-        TracerContext* tracer, TraceNodeContext* node)
+template <typename Payload>
+static bool NumericPayload(Payload const& payload, double* out)
+{
+    auto fnVisitor =
+            [&](auto&& value) {
+                using ValueType = decay_t<decltype(value)>;
+
+                if constexpr (is_convertible_v<ValueType, double>) {
+                    return *out = double(value), true;
+                } else if constexpr (is_same_v<ValueType, steady_clock::duration>) {
+                    return *out = to_seconds(value), true;
+                } else {
+                    return false;
+                }
+            };
+
+    return std::visit(fnVisitor, payload);
+}
+
+static void DrawSparkline(
+        ImDrawList* dl, ImVec2 at, ImVec2 size,
+        float const* ring, uint32_t length, uint32_t count, ImU32 color)
 {
-    auto nodeFlags = ImGuiTreeNodeFlags_AllowItemOverlap | ImGuiTreeNodeFlags_SpanFullWidth | ImGuiTreeNodeFlags_DefaultOpen;
+    constexpr uint32_t MAX_POINTS = 128;
+    ImVec2 points[MAX_POINTS];
 
-    if (node->children.empty())
+    auto const numPoints = std::min({count, length, MAX_POINTS});
+    auto const first = count - numPoints;
+
+    auto [minIter, maxIter] = std::minmax_element(ring, ring + std::min(count, length));
+    auto const range = *maxIter - *minIter;
+
+    for (uint32_t i = 0; i < numPoints; ++i) {
+        auto value = ring[(first + i) % length];
+        auto y = range > 0 ? (value - *minIter) / range : .5f;
+
+        points[i].x = at.x + size.x * float(i) / float(numPoints - 1);
+        points[i].y = at.y + size.y * (1 - y);
+    }
+
+    dl->AddPolyline(points, int(numPoints), color, 0, 1.f);
+}
+
+void widgets::TraceWindow::_rebuildTraceRows(TracerContext* tracer)
+{
+    auto& rows = tracer->_rows;
+    auto& store = tracer->nodes;
+    rows.clear();
+
+    // While filtering, only matches and their ancestors are listed, expanded.
+    bool const bFiltering = not _filter.empty();
+    auto const fnIsVisible
+            = [&](int index) {
+                  return not bFiltering || store.Test(index, TraceNode_FilterMatch | TraceNode_FilterPath);
+              };
+
+    // Depth first, children of collapsed nodes are skipped.
+    vector<TraceRow> stack;
+    for (auto iter = tracer->rootNodeIndices.rbegin(); iter != tracer->rootNodeIndices.rend(); ++iter)
+        if (fnIsVisible(*iter)) { stack.push_back({*iter, 0}); }
+
+    while (not stack.empty()) {
+        auto row = stack.back();
+        stack.pop_back();
+        rows.push_back(row);
+
+        bool const bExpanded = bFiltering ? store.Test(row.nodeIndex, TraceNode_FilterPath)
+                                          : not store.Test(row.nodeIndex, TraceNode_Collapsed);
+        if (not bExpanded) { continue; }
+
+        auto [begin, end] = store.Children(row.nodeIndex);
+        while (begin != end)
+            if (auto child = *--end; fnIsVisible(child)) { stack.push_back({child, row.depth + 1}); }
+    }
+}
+
+void widgets::TraceWindow::_drawTraceNodeRow(
+        TracerContext* tracer, int index, int depth)
+{
+    auto& store = tracer->nodes;
+    auto const& name = _names[store.nameIds[index]];
+    auto nodeFlags = ImGuiTreeNodeFlags_AllowItemOverlap | ImGuiTreeNodeFlags_SpanFullWidth | ImGuiTreeNodeFlags_NoTreePushOnOpen;
+
+    if (not store.HasChildren(index))
         nodeFlags |= ImGuiTreeNodeFlags_Leaf;
 
+    // Rows are flattened, thus indent manually instead of pushing tree.
+    auto const indent = float(depth) * ImGui::GetStyle().IndentSpacing;
+    if (indent > 0) { ImGui::Indent(indent); }
+
+    // While replaying, fence and value are taken from the replayed state instead.
+    bool const bReplaying = tracer->_replay != nullptr;
+    bool const bReplayed = bReplaying && size_t(index) < tracer->_replayPayloads.size();
+    auto const nodeFence = bReplaying ? (bReplayed ? tracer->_replayFences[index] : 0) : store.fences[index];
+    auto const& payload = bReplayed ? tracer->_replayPayloads[index] : store.payloads[index];
+
     // Highlight node text if node is latest ...
     using std::chrono::duration_cast;
-    bool const bIsActiveNode = node->data.fence_value == tracer->fence;
+    bool const bIsActiveNode = nodeFence == (bReplaying ? tracer->_replayFence : tracer->fence);
+    bool const bCollapsed = store.Test(index, TraceNode_Collapsed);
+    bool const bSubscribed = store.Test(index, TraceNode_Subscribed);
+    bool const bPlotting = store.Test(index, TraceNode_Plotting);
+
+    bool const bFiltering = not _filter.empty();
+    bool const bShownOpen = bFiltering ? store.Test(index, TraceNode_FilterPath) : not bCollapsed;
 
-    if (bIsActiveNode)
+    if (store.Test(index, TraceNode_FilterMatch))
+        ImGui::PushStyleColor(ImGuiCol_Text, ColorRefs::FrontWarn);
+    else if (bIsActiveNode)
         ImGui::PushStyleColor(ImGuiCol_Text, 0xffbbbbbb);
     else
         ImGui::PushStyleColor(ImGuiCol_Text, ImGui::GetColorU32(ImGuiCol_TextDisabled));
 
     // Draw node label
-    bool const bSkipChildren = not ImGui::TreeNodeEx(node->info.name.c_str(), nodeFlags);
+    ImGui::SetNextItemOpen(bShownOpen);
+    bool const bOpen = ImGui::TreeNodeEx(name.c_str(), nodeFlags);
     bool const bNodeToggleOpened = ImGui::IsItemToggledOpen();
     ImGui::PopStyleColor();
 
+    // Open state is driven by filter while filtering.
+    if (not bFiltering && bOpen == bCollapsed) {
+        store.Set(index, TraceNode_Collapsed, not bOpen);
+        tracer->_bRowsDirty = true;
+    }
+
     //    bool const bShowContentTooltip = ImGui::IsItemHovered();
     bool bToggleSubsription = ImGui::IsItemClicked(ImGuiMouseButton_Right);
     bool bTogglePlotWindow = ImGui::IsItemClicked() && ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left);
@@ -317,7 +858,7 @@ void widgets::TraceWindow::_recurseRootTraceNode(
             };
 
     ImGui::SameLine();
-    if (node->data.ref_subscr()) {
+    if (bSubscribed) {
         if (drawDot(0x00ff00)) {
             bToggleSubsription = true;
         }
@@ -328,15 +869,14 @@ void widgets::TraceWindow::_recurseRootTraceNode(
     }
 
     ImGui::SameLine(0, 0);
-    if (node->_hPlot) {
+    if (store.plots.count(index)) {
         // Draw red dot on plot recording
 
-        if (drawDot(node->_bPlotting ? 0x0000ff : 0x00ffff)) {
-            node->_hPlot.Expire();
-            node->_bPlotting = false;
+        if (drawDot(bPlotting ? 0x0000ff : 0x00ffff)) {
+            _stopPlotting(tracer, index);
         }
 
-        if (bIsActiveNode && node->_bPlotting) {
+        if (bIsActiveNode && bPlotting) {
             ImGui::SameLine();
             ImGui::PushStyleColor(ImGuiCol_Text, ColorRefs::FrontError);
             ImGui::TextUnformatted("REC");
@@ -348,17 +888,49 @@ void widgets::TraceWindow::_recurseRootTraceNode(
         drawDot();
     }
 
+    // Draw statistics columns
+    if (auto& summary = store.stats[index]; _bShowStats && summary.count > 0) {
+        bool const bDuration = std::holds_alternative<steady_clock::duration>(payload);
+        float const values[NUM_STATS_COLUMNS] = {summary.min, summary.mean, summary.max, summary.p50, summary.p90, summary.p99};
+
+        for (int i = 0; i < NUM_STATS_COLUMNS; ++i) {
+            auto text = bDuration ? usprintf("%.3f", values[i] * 1e3) : usprintf("%.4g", values[i]);
+            auto width = ImGui::CalcTextSize(text).x;
+
+            ImGui::SameLine();
+            ImGui::SetCursorPosX(std::max(ImGui::GetCursorPosX(), StatsColumnRight(i) - width));
+            ImGui::TextDisabled("%s", text);
+        }
+    }
+
     // Draw node value
     ImGui::SameLine();
     {
         auto& builder = _reusedStringBuilder;
         builder.clear();
 
-        ImU32 color = std::visit([&](auto&& e) { return VisitPayloadEntity(&builder, e); }, node->data.payload);
+        ImU32 color = bReplaying && not bReplayed
+                              ? ImGui::GetColorU32(ImGuiCol_TextDisabled)
+                              : std::visit([&](auto&& e) { return VisitPayloadEntity(&builder, e); }, payload);
         ImGui::PushStyleColor(ImGuiCol_Text, color);
 
         auto size = ImGui::CalcTextSize(builder.data(), builder.data() + builder.size());
-        ImGui::SetCursorPosX(std::max(ImGui::GetCursorPosX(), ImGui::GetContentRegionMax().x - size.x));
+        auto valueX = std::max(ImGui::GetCursorPosX(), ImGui::GetContentRegionMax().x - size.x);
+
+        // Draw recent trend left to the value. History is of live values, thus hidden while
+        //  replaying.
+        if (auto [ring, count] = store.History(index); count > 1 && not bReplaying) {
+            auto const sparkSize = ImVec2{64 * DpiScale(), ImGui::GetTextLineHeight()};
+            auto const spacing = ImGui::GetStyle().ItemSpacing.x;
+            valueX = std::max(valueX, ImGui::GetCursorPosX() + sparkSize.x + spacing);
+
+            auto at = ImGui::GetCursorScreenPos();
+            at.x += valueX - ImGui::GetCursorPosX() - sparkSize.x - spacing;
+
+            DrawSparkline(dl, at, sparkSize, ring, TraceNodeStore::HISTORY_LENGTH, count, (color & 0x00ffffff) | 0x99000000);
+        }
+
+        ImGui::SetCursorPosX(valueX);
 
         ImGui::Selectable("##SEL_ACT");
         ImGui::SameLine(0, 0);
@@ -380,104 +952,704 @@ void widgets::TraceWindow::_recurseRootTraceNode(
     }
 
     if (bTogglePlotWindow) {
-        if (not node->_hPlot) {
+        auto& hPlot = store.plots[index];
+
+        if (not hPlot) {
             string hostName;
             hostName.reserve(64);
 
-            auto cursor = node;
-
-            for (;;) {
-                if (cursor->info.parent_index != -1) {
-                    cursor = tracer->nodes[cursor->info.parent_index].get();
-                    hostName.append(cursor->info.name.rbegin(), cursor->info.name.rend());
-                    hostName += '.';
-                } else {
-                    break;
-                }
+            for (auto cursor = store.parents[index]; cursor != -1; cursor = store.parents[cursor]) {
+                auto& parentName = _names[store.nameIds[cursor]];
+                hostName.append(parentName.rbegin(), parentName.rend());
+                hostName += '.';
             }
 
             hostName.append(tracer->info.name.rbegin(), tracer->info.name.rend());
             reverse(hostName);
 
-            node->_hPlot = CreateTimePlot(fmt::format("{} ({})", node->info.name, hostName));
+            hPlot = CreateTimePlot(fmt::format("{} ({})", name, hostName));
         }
 
-        node->_bPlotting = not node->_bPlotting;
+        store.Set(index, TraceNode_Plotting, not bPlotting);
+        _setPlotSink(tracer, index, not bPlotting);
     } else if (bToggleSubsription) {
         // Toggle subscription state
         proto::service::trace_control_t arg;
-        arg.subscribe = not node->data.ref_subscr();
+        arg.subscribe = not bSubscribed;
 
         proto::service::trace_request_control(_host->RpcSession())
-                .notify(tracer->info.tracer_id, node->info.index, arg);
+                .notify(tracer->info.tracer_id, index, arg);
     }
 
-    if (bSkipChildren) { return; }
-
-    if (bNodeToggleOpened && node->_bCildrenListPendingSort) {
-        node->_bCildrenListPendingSort = false;
+    if (bOpen && bNodeToggleOpened && store.Test(index, TraceNode_PendingSort)) {
+        store.Set(index, TraceNode_PendingSort, false);
 
         // TODO: Sort node's children by their fence, to make fresh nodes
         //  precede obsolete ones.
     }
 
-    for (auto idx : node->children) {
-        _recurseRootTraceNode(tracer, tracer->nodes[idx].get());
+    if (indent > 0) { ImGui::Unindent(indent); }
+}
+
+void widgets::TraceWindow::_captureFlameFrame(TracerContext* tracer)
+{
+    auto& store = tracer->nodes;
+    auto& frames = tracer->_flameFrames;
+    vector<Trace::FlameSample> samples;
+
+    // Tracer has been restarted
+    if (not frames.empty() && frames.back().fence >= tracer->fence) { frames.clear(); }
+
+    for (size_t i = 0; i < store.Size(); ++i) {
+        if (not store.Exists(i) || store.fences[i] != tracer->fence) { continue; }
+
+        if (auto duration = std::get_if<steady_clock::duration>(&store.payloads[i]))
+            samples.push_back({int(i), store.parents[i], store.nameIds[i], to_seconds(*duration)});
     }
 
-    ImGui::TreePop();
+    if (samples.empty()) { return; }
+
+    frames.push_back({tracer->fence, nullptr});
+    while (frames.size() > MAX_FLAME_FRAMES) { frames.pop_front(); }
+
+    PostAsyncEvent(
+            [this, anchor = _host->SessionAnchor(), tracerId = tracer->info.tracer_id,
+             fence = tracer->fence, samples = move(samples)]() mutable {
+                auto layout = make_shared<Trace::FlameLayout>();
+                layout->fence = fence;
+                Trace::LayoutFlameGraph(move(samples), layout.get());
+
+                PostEventMainThreadWeak(anchor, [this, tracerId, layout = move(layout)]() mutable {
+                    auto tracer = _findTracer(tracerId);
+                    if (tracer == nullptr) { return; }
+
+                    // Frame may have been evicted meanwhile.
+                    auto& frames = tracer->_flameFrames;
+                    auto iter = std::lower_bound(
+                            frames.begin(), frames.end(), layout->fence,
+                            [](FlameFrame const& frame, uint64_t fence) { return frame.fence < fence; });
+
+                    if (iter != frames.end() && iter->fence == layout->fence)
+                        iter->layout = move(layout);
+                });
+            });
+}
+
+void widgets::TraceWindow::_drawFlameGraph(TracerContext* tracer)
+{
+    auto& frames = tracer->_flameFrames;
+    if (frames.empty()) {
+        ImGui::TextDisabled("Waiting for durations of subscribed nodes ...");
+        return;
+    }
+
+    /// Draw fence scrubber. Dragging to the end follows latest fence.
+    int const last = int(frames.size()) - 1;
+    int position = last;
+
+    if (tracer->_flameFence != 0) {
+        auto iter = std::lower_bound(
+                frames.begin(), frames.end(), tracer->_flameFence,
+                [](FlameFrame const& frame, uint64_t fence) { return frame.fence < fence; });
+
+        position = std::min(int(iter - frames.begin()), last);
+    }
+
+    ImGui::SetNextItemWidth(-1);
+    auto label = usprintf("fence %llu%s", frames[position].fence, position == last ? " (latest)" : "");
+    if (ImGui::SliderInt("##FlameFence", &position, 0, last, label)) {
+        tracer->_flameFence = position == last ? 0 : frames[position].fence;
+    }
+
+    if (auto& layout = frames[position].layout) { tracer->_flameShown = layout; }
+
+    auto layout = tracer->_flameShown.get();
+    if (layout == nullptr || layout->rects.empty()) { return; }
+
+    /// Draw rects
+    auto const rowHeight = ImGui::GetTextLineHeightWithSpacing();
+    auto const width = ImGui::GetContentRegionAvail().x;
+    auto const origin = ImGui::GetCursorScreenPos();
+
+    ImGui::InvisibleButton("##Flame", {width, rowHeight * float(layout->numDepths)});
+    bool const bHovered = ImGui::IsItemHovered();
+    auto const mouse = ImGui::GetIO().MousePos;
+
+    auto dl = ImGui::GetWindowDrawList();
+    Trace::FlameRect const* hovered = nullptr;
+
+    for (auto& rect : layout->rects) {
+        ImVec2 p0{origin.x + float(rect.x0) * width, origin.y + float(rect.depth) * rowHeight};
+        ImVec2 p1{origin.x + float(rect.x1) * width, p0.y + rowHeight - 1};
+
+        // Too narrow to be seen
+        if (p1.x - p0.x < 1) { continue; }
+
+        // Same scope keeps same color over fences
+        auto hue = float((rect.nameId * 2654435761u) >> 16 & 0xffff) / 65536.f;
+        ImU32 color = ImColor::HSV(.12f * hue, .65f, .9f);
+        dl->AddRectFilled(p0, p1, color);
+
+        auto& name = _names[rect.nameId];
+        ImVec4 clip{p0.x, p0.y, p1.x - 2, p1.y};
+        dl->AddText(nullptr, 0, {p0.x + 2, p0.y}, 0xff000000, name.c_str(), nullptr, 0, &clip);
+
+        if (bHovered && mouse.x >= p0.x && mouse.x < p1.x && mouse.y >= p0.y && mouse.y < p1.y)
+            hovered = &rect;
+    }
+
+    if (hovered) {
+        ImGui::BeginTooltip();
+        ImGui::TextUnformatted(_names[hovered->nameId].c_str());
+        ImGui::TextColored(ImColor(ColorRefs::GlyphUserType), "%.3f ms", hovered->seconds * 1e3);
+        ImGui::SameLine();
+        ImGui::TextDisabled("(%.1f%% of fence %llu)", hovered->seconds / layout->totalSeconds * 100., layout->fence);
+        ImGui::EndTooltip();
+    }
+}
+
+void widgets::TraceWindow::_takeSnapshot(TracerContext* tracer)
+{
+    auto& store = tracer->nodes;
+    auto label = fmt::format("{} / {} @ {}", _host->DisplayString(), tracer->info.name, tracer->fence);
+    auto snapshot = make_shared<Trace::Snapshot>(move(label), tracer->fence);
+
+    string path;
+    path.reserve(64);
+
+    for (size_t i = 0; i < store.Size(); ++i) {
+        double value;
+        if (not store.Exists(i) || not NumericPayload(store.payloads[i], &value)) { continue; }
+
+        path.clear();
+        for (auto cursor = int(i); cursor != -1 && store.Exists(cursor); cursor = store.parents[cursor]) {
+            auto& name = _names[store.nameIds[cursor]];
+            path.append(name.rbegin(), name.rend());
+            path += '.';
+        }
+
+        path.pop_back();
+        reverse(path);
+
+        // Nodes not updated at this fence are kept along with their own fence, and marked
+        //  stale on comparison.
+        bool const bDuration = std::holds_alternative<steady_clock::duration>(store.payloads[i]);
+        snapshot->Add(path, value, store.fences[i], bDuration);
+    }
+
+    snapshot->Seal();
+    NotifyToast{LOCWORD("Trace")}.String("Snapshot '{}' taken, {} nodes", snapshot->Label(), snapshot->Entries().size());
+
+    SnapshotRegistry()->push_back(move(snapshot));
+}
+
+void widgets::TraceWindow::_requestSnapshotDiff()
+{
+    auto diff = make_shared<SnapshotDiff>();
+    diff->base = _diffBase;
+    diff->target = _diffTarget;
+    _bDiffPending = true;
+
+    PostAsyncEvent(
+            [this, anchor = _host->SessionAnchor(), diff = move(diff)]() mutable {
+                Trace::DiffSnapshots(*diff->base, *diff->target, &diff->rows);
+
+                PostEventMainThreadWeak(anchor, [this, diff = move(diff)]() mutable {
+                    // Discard outdated result, as selection has changed meanwhile.
+                    if (diff->base != _diffBase || diff->target != _diffTarget) { return; }
+
+                    _diff = move(diff);
+                    _bDiffPending = false;
+                });
+            });
+}
+
+void widgets::TraceWindow::_drawSnapshotDiff()
+{
+    auto& snapshots = *SnapshotRegistry();
+    if (not ImGui::CollapsingHeader(usprintf("Compare (%zu snapshots)###Compare", snapshots.size())))
+        return;
+
+    ImGui::PushID("Compare");
+    CPPH_FINALLY(ImGui::PopID());
+
+    /// Draw snapshot selection
+    auto const fnCombo
+            = [&](char const* label, shared_ptr<Trace::Snapshot const>* selected) {
+                  bool bChanged = false;
+                  auto preview = *selected ? (*selected)->Label().c_str() : "(none)";
+
+                  if (CondInvoke(ImGui::BeginCombo(label, preview), ImGui::EndCombo)) {
+                      for (size_t i = 0; i < snapshots.size(); ++i) {
+                          ImGui::PushID(int(i));
+                          if (ImGui::Selectable(snapshots[i]->Label().c_str(), snapshots[i] == *selected)) {
+                              *selected = snapshots[i];
+                              bChanged = true;
+                          }
+                          ImGui::PopID();
+                      }
+                  }
+
+                  return bChanged;
+              };
+
+    bool bSelectionChanged = fnCombo("Base", &_diffBase);
+    bSelectionChanged |= fnCombo("Target", &_diffTarget);
+
+    if (bSelectionChanged && _diffBase && _diffTarget) {
+        _requestSnapshotDiff();
+    }
+
+    if (ImGui::SmallButton("Clear Snapshots")) {
+        snapshots.clear();
+        _diffBase.reset();
+        _diffTarget.reset();
+        _diff.reset();
+        _bDiffPending = false;
+        return;
+    }
+
+    if (_bDiffPending) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("Comparing ...");
+    }
+
+    if (not _diff) { return; }
+
+    /// Draw rows, worst regression first. Durations are in seconds.
+    auto& rows = _diff->rows;
+    auto const tableFlags = ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_Resizable;
+
+    if (CondInvoke(ImGui::BeginTable("##Diff", 5, tableFlags, {0, 240 * DpiScale()}), ImGui::EndTable)) {
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableSetupColumn("Path", ImGuiTableColumnFlags_WidthStretch);
+        ImGui::TableSetupColumn("Base");
+        ImGui::TableSetupColumn("Target");
+        ImGui::TableSetupColumn("Delta");
+        ImGui::TableSetupColumn("%");
+        ImGui::TableHeadersRow();
+
+        auto const fnValue
+                = [](double value, ImU32 color = 0) {
+                      ImGui::TableNextColumn();
+
+                      if (std::isnan(value))
+                          ImGui::TextDisabled("-");
+                      else if (color)
+                          ImGui::TextColored(ImColor(color), "%.6g", value);
+                      else
+                          ImGui::Text("%.6g", value);
+                  };
+
+        ImGuiListClipper clipper;
+        clipper.Begin(int(rows.size()));
+
+        while (clipper.Step()) {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+                auto& row = rows[i];
+                auto color = row.delta > 0 ? ColorRefs::FrontError : row.delta < 0 ? ColorRefs::FrontOkay : 0u;
+
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+
+                if (row.bStale) {
+                    ImGui::TextDisabled("%.*s", int(row.path.size()), row.path.data());
+                    if (ImGui::IsItemHovered()) { ImGui::SetTooltip("Not updated at the fence of snapshot"); }
+                } else {
+                    ImGui::TextUnformatted(row.path.data(), row.path.data() + row.path.size());
+                }
+
+                fnValue(row.base);
+                fnValue(row.target);
+                fnValue(row.delta, color);
+                fnValue(row.percent, color);
+            }
+        }
+    }
+}
+
+auto widgets::TraceWindow::_recordDirectory(bool* bTemporary) -> std::filesystem::path
+{
+    std::error_code ec;
+
+    if (string configured = *GConfig::Widgets::TraceRecordDirectory; not configured.empty()) {
+        *bTemporary = false;
+        std::filesystem::create_directories(configured, ec);
+        return configured;
+    }
+
+    *bTemporary = true;
+    if (not _recordTempDir.empty()) { return _recordTempDir; }
+
+    auto dir = std::filesystem::temp_directory_path(ec);
+    if (ec) { dir = "."; }
+
+    std::random_device rd;
+    _recordTempDir = dir / fmt::format("perfkit-dashboard-trace-{:08x}{:08x}", rd(), rd());
+    std::filesystem::create_directories(_recordTempDir, ec);
+    return _recordTempDir;
+}
+
+void widgets::TraceWindow::_setRecording(TracerContext* tracer, bool bEnable)
+{
+    auto const tracerId = tracer->info.tracer_id;
+    std::lock_guard _{_recordLock};
+
+    if (not bEnable) {
+        _recorders.erase(tracerId);
+        tracer->bRecording = false;
+        return;
+    }
+
+    bool bTemporary;
+    auto dir = _recordDirectory(&bTemporary);
+    auto base = (dir / fmt::format("trace-{}-{}", tracerId, std::chrono::system_clock::now().time_since_epoch() / 1s)).string();
+    auto writer = make_unique<Trace::RecordWriter>();
+
+    if (not writer->Open(base)) {
+        NotifyToast{LOCWORD("Trace")}.Error().String("Failed to open recording '{}'", base);
+        return;
+    }
+
+    NotifyToast{LOCWORD("Trace")}.String("Recording '{}' to '{}'", tracer->info.name, base);
+
+    // Previous temporary recording is unreachable from now on, unless it's being replayed;
+    //  then it's left until the temporary directory is removed.
+    if (tracer->_bRecordTemporary && not tracer->_replay) {
+        std::error_code ec;
+        std::filesystem::remove(Trace::Recording::DataPath(tracer->recordPath), ec);
+        std::filesystem::remove(Trace::Recording::IndexPath(tracer->recordPath), ec);
+    }
+
+    _recorders[tracerId] = move(writer);
+    tracer->recordPath = move(base);
+    tracer->bRecording = true;
+    tracer->_bRecordTemporary = bTemporary;
+}
+
+void widgets::TraceWindow::_setReplaying(TracerContext* tracer, bool bEnable)
+{
+    if (bEnable) {
+        auto reader = make_unique<Trace::RecordReader>();
+
+        if (not reader->Open(tracer->recordPath) || reader->NumRecords() == 0) {
+            NotifyToast{LOCWORD("Trace")}.Warning().String("Nothing has been recorded to '{}'", tracer->recordPath);
+            return;
+        }
+
+        tracer->_replay = move(reader);
+        _seekReplay(tracer, tracer->_replay->NumRecords() - 1);
+    } else {
+        // Nodes are up to date, as live updates have never stopped.
+        tracer->_replay.reset();
+        tracer->_replayFences = {};
+        tracer->_replayPayloads = {};
+    }
+}
+
+void widgets::TraceWindow::_seekReplay(TracerContext* tracer, size_t record)
+{
+    auto& reader = *tracer->_replay;
+    auto& store = tracer->nodes;
+
+    vector<Trace::RecordEntry> state;
+    if (not reader.ReadState(record, &state)) {
+        NotifyToast{LOCWORD("Trace")}.Error().String("Recording '{}' is malformed", tracer->recordPath);
+        return;
+    }
+
+    // Nodes which hadn't been updated until the record are left empty.
+    tracer->_replayFences.assign(store.Size(), 0);
+    tracer->_replayPayloads.assign(store.Size(), nullptr);
+
+    for (auto& entry : state) {
+        if (not store.Exists(entry.index)) { continue; }
+
+        tracer->_replayFences[entry.index] = entry.fence;
+        std::visit([&](auto&& value) { tracer->_replayPayloads[entry.index] = value; }, entry.payload);
+    }
+
+    tracer->_replayPosition = record;
+    tracer->_replayFence = reader.FenceAt(record);
+}
+
+void widgets::TraceWindow::_drawReplayControl(TracerContext* tracer)
+{
+    auto& reader = *tracer->_replay;
+    auto const numRecords = reader.NumRecords();
+    if (numRecords == 0) { return; }
+
+    /// Seek by fence
+    uint64_t fence = tracer->_replayFence;
+    ImGui::SetNextItemWidth(120 * DpiScale());
+
+    if (ImGui::InputScalar("##ReplayFence", ImGuiDataType_U64, &fence, nullptr, nullptr, "%llu", ImGuiInputTextFlags_EnterReturnsTrue)) {
+        _seekReplay(tracer, std::min(reader.Find(fence), numRecords - 1));
+    }
+
+    if (ImGui::IsItemHovered()) { ImGui::SetTooltip("Enter fence to seek"); }
+
+    /// Scrub records
+    int position = int(tracer->_replayPosition);
+    int const last = int(numRecords) - 1;
+
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(-1);
+    ImGui::PushStyleColor(ImGuiCol_FrameBg, ColorRefs::BackWarn);
+
+    auto label = usprintf("REPLAY %d / %d", position + 1, last + 1);
+    if (ImGui::SliderInt("##ReplayRecord", &position, 0, last, label)) {
+        _seekReplay(tracer, size_t(position));
+    }
+
+    ImGui::PopStyleColor();
+}
+
+void widgets::TraceWindow::_setPlotSink(TracerContext* tracer, int index, bool bEnable)
+{
+    std::lock_guard _{_plotSinkLock};
+    auto key = make_pair(tracer->info.tracer_id, uint64_t(index));
+
+    if (bEnable)
+        _plotSinks[key] = tracer->nodes.plots[index];
+    else
+        _plotSinks.erase(key);
+}
+
+void widgets::TraceWindow::_stopPlotting(TracerContext* tracer, int index)
+{
+    auto& store = tracer->nodes;
+    _setPlotSink(tracer, index, false);
+
+    if (auto iter = store.plots.find(index); iter != store.plots.end()) {
+        iter->second.Expire();
+        store.plots.erase(iter);
+    }
+
+    store.Set(index, TraceNode_Plotting, false);
+}
+
+void widgets::TraceWindow::_erasePlotSinks(uint64_t tracerId)
+{
+    std::lock_guard _{_plotSinkLock};
+    auto begin = _plotSinks.lower_bound(make_pair(tracerId, uint64_t{}));
+    auto end = _plotSinks.lower_bound(make_pair(tracerId + 1, uint64_t{}));
+    _plotSinks.erase(begin, end);
 }
 
 void widgets::TraceWindow::_fnOnTraceUpdate(
         uint64_t tracer_id, vector<proto::trace_update_t>& updates)
 {
-    PostEventMainThreadWeak(
-            _host->SessionAnchor(), [this, tracer_id, updates] {
-                if (auto tracer = _findTracer(tracer_id)) {
-                    tracer->_actualDeltaUpdateSec = float(tracer->_tmActualDeltaUpdate.elapsed().count());
-                    tracer->_tmActualDeltaUpdate.reset();
-
-                    tracer->tmNextPublish.reset();
-
-                    tracer->_fencePrev = tracer->fence;
-                    tracer->_updateGap = 0;
-                    tracer->_waitExpiry = {};
-
-                    auto nodes = &tracer->nodes;
-
-                    for (auto& update : updates) {
-                        // Update fence
-                        tracer->fence = max(tracer->fence, uint64_t(update.fence_value));
-
-                        // Ignore updates that can't be processed
-                        if (nodes->size() <= update.index)
-                            continue;
-
-                        auto node = (*nodes)[update.index].get();
-                        assert(node->info.index == update.index);
-                        node->data = update;
-                        node->_updateAt = steady_clock::now();
-                        node->_bCildrenListPendingSort = true;
-
-                        if (node->_bPlotting) {
-                            // Push data to plot if payload is convertible to double
-                            auto fnVisitor =
-                                    [node](auto&& value) {
-                                        using ValueType = decay_t<decltype(value)>;
-
-                                        if constexpr (is_convertible_v<ValueType, double>) {
-                                            node->_hPlot.Commit(double(value));
-                                        } else if constexpr (is_same_v<ValueType, steady_clock::duration>) {
-                                            node->_hPlot.Commit(to_seconds(value));
-                                        } else {
-                                            node->_hPlot.Expire();
-                                            node->_bPlotting = false;
-                                        }
-                                    };
-
-                            std::visit(fnVisitor, node->data.payload);
+    // Commit plotted values on this thread directly. Values are stamped with the time this
+    //  batch arrived, which is free from main thread queueing delay.
+    auto const timeRecv = steady_clock::now();
+
+    auto const fnOutOfRange = [](auto& update) { return uint64_t(update.index) >= MAX_NODE_INDEX; };
+    if (std::any_of(updates.begin(), updates.end(), fnOutOfRange)) {
+        spdlog::warn("Dropping trace updates of tracer {} with node index out of range", tracer_id);
+        updates.erase(std::remove_if(updates.begin(), updates.end(), fnOutOfRange), updates.end());
+    }
+
+    {
+        std::lock_guard _{_plotSinkLock};
+        auto begin = _plotSinks.lower_bound(make_pair(tracer_id, uint64_t{}));
+        auto end = _plotSinks.lower_bound(make_pair(tracer_id + 1, uint64_t{}));
+
+        for (auto& update : updates) {
+            if (begin == end) { break; }  // No node of this tracer is being plotted.
+
+            auto iter = _plotSinks.find(make_pair(tracer_id, uint64_t(update.index)));
+            if (iter == _plotSinks.end()) { continue; }
+
+            auto fnVisitor =
+                    [&](auto&& value) {
+                        using ValueType = decay_t<decltype(value)>;
+
+                        if constexpr (is_convertible_v<ValueType, double>) {
+                            iter->second.Commit(double(value), timeRecv);
+                        } else if constexpr (is_same_v<ValueType, steady_clock::duration>) {
+                            iter->second.Commit(to_seconds(value), timeRecv);
                         }
-                    }
-                }
-            });
+                    };
+
+            std::visit(fnVisitor, update.payload);
+        }
+    }
+
+    // Accumulate statistics from every update, before coalescing.
+    {
+        std::lock_guard _{_statsLock};
+        auto& table = _stats[tracer_id];
+
+        for (auto& update : updates) {
+            double value;
+            if (not NumericPayload(update.payload, &value)) { continue; }
+
+            auto& window = table.windows[int(update.index)];
+            window.stats.Push(float(value));
+
+            if (not exchange(window.bDirty, true))
+                table.dirty.push_back(int(update.index));
+        }
+    }
+
+    // Record every batch as is, before coalescing.
+    {
+        std::lock_guard _{_recordLock};
+
+        if (auto iter = _recorders.find(tracer_id); iter != _recorders.end()) {
+            _recordBuffer.clear();
+
+            for (auto& update : updates) {
+                auto& entry = _recordBuffer.emplace_back();
+                entry.index = uint32_t(update.index);
+                entry.fence = update.fence_value;
+                entry.bSubscribed = update.ref_subscr();
+                std::visit([&](auto&& value) { entry.payload = value; }, update.payload);
+            }
+
+            if (not iter->second->Append(_recordBuffer)) {
+                _recorders.erase(iter);
+
+                PostEventMainThreadWeak(
+                        _host->SessionAnchor(), [this, tracer_id] {
+                            auto tracer = _findTracer(tracer_id);
+                            if (tracer == nullptr) { return; }
+
+                            tracer->bRecording = false;
+                            NotifyToast{LOCWORD("Trace")}.Error().String("Failed to write recording '{}'; stopped", tracer->recordPath);
+                        });
+            }
+        }
+    }
+
+    // Coalesce into staging buffer; later updates of a node overwrite earlier ones.
+    std::lock_guard _{_stagingLock};
+    auto& staged = _staging[tracer_id];
+    ++staged.numBatches;
+
+    for (auto& update : updates) {
+        if (staged.slotOf.size() <= update.index)
+            staged.slotOf.resize(update.index + 1, -1);
+
+        auto& slot = staged.slotOf[update.index];
+
+        if (slot < 0) {
+            slot = int(staged.updates.size());
+            staged.updates.push_back(move(update));
+        } else {
+            staged.updates[slot] = move(update);
+        }
+    }
+}
+
+void widgets::TraceWindow::_applyStagedUpdates()
+{
+    {
+        std::lock_guard _{_stagingLock};
+        swap(_staging, _stagingApply);
+    }
+
+    for (auto iter = _stagingApply.begin(); iter != _stagingApply.end();) {
+        auto& [tracerId, staged] = *iter;
+        auto tracer = _findTracer(tracerId);
+
+        if (tracer == nullptr) {
+            iter = _stagingApply.erase(iter);
+            continue;
+        }
+
+        if (staged.numBatches == 0) {
+            ++iter;
+            continue;
+        }
+
+        auto const fencePrev = tracer->fence;
+        bool bFenceAdvanced = false;
+
+        if (not staged.updates.empty()) {
+            _applyTraceUpdates(tracer, staged.updates);
+            bFenceAdvanced = tracer->fence != fencePrev;
+        }
+
+        _schedulePoll(tracer, bFenceAdvanced);
+
+        for (auto& update : staged.updates) { staged.slotOf[update.index] = -1; }
+        staged.updates.clear();
+        staged.numBatches = 0;
+        ++iter;
+    }
+}
+
+void widgets::TraceWindow::_applyStatsUpdates()
+{
+    std::lock_guard _{_statsLock};
+
+    for (auto& [tracerId, table] : _stats) {
+        if (table.dirty.empty()) { continue; }
+
+        auto tracer = _findTracer(tracerId);
+
+        for (auto index : table.dirty) {
+            auto& window = table.windows[index];
+            window.bDirty = false;
+
+            if (tracer && tracer->nodes.Exists(index))
+                tracer->nodes.stats[index] = window.stats.Summary();
+        }
+
+        table.dirty.clear();
+    }
+}
+
+void widgets::TraceWindow::_applyTraceUpdates(TracerContext* tracer, vector<proto::trace_update_t>& updates)
+{
+    tracer->_actualDeltaUpdateSec = float(tracer->_tmActualDeltaUpdate.elapsed().count());
+    tracer->_tmActualDeltaUpdate.reset();
+
+    tracer->_fencePrev = tracer->fence;
+    tracer->_updateGap = 0;
+
+    auto store = &tracer->nodes;
+
+    for (auto& update : updates) {
+        // Update fence
+        tracer->fence = max(tracer->fence, uint64_t(update.fence_value));
+
+        // Ignore updates that can't be processed
+        if (not store->Exists(update.index))
+            continue;
+
+        auto index = int(update.index);
+        store->fences[index] = update.fence_value;
+        store->Set(index, TraceNode_Subscribed, update.ref_subscr());
+        store->payloads[index] = move(update.payload);
+        store->Set(index, TraceNode_PendingSort, true);
+
+        // Subscribed numeric nodes keep recent samples for sparkline
+        if (double value; update.ref_subscr() && NumericPayload(store->payloads[index], &value))
+            store->PushHistory(index, float(value));
+        else
+            store->ReleaseHistory(index);
+
+        if (store->Test(index, TraceNode_Plotting)) {
+            // Values are already committed from RPC thread. Only stop
+            //  plotting if payload is not convertible to double.
+            auto fnVisitor =
+                    [&](auto&& value) {
+                        using ValueType = decay_t<decltype(value)>;
+
+                        if constexpr (not is_convertible_v<ValueType, double>
+                                      && not is_same_v<ValueType, steady_clock::duration>) {
+                            _stopPlotting(tracer, index);
+                        }
+                    };
+
+            std::visit(fnVisitor, store->payloads[index]);
+        }
+    }
+
+    if (tracer->bShowFlame && tracer->fence != tracer->_fencePrev) {
+        _captureFlameFrame(tracer);
+    }
 }
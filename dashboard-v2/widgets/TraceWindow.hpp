@@ -3,10 +3,17 @@
 //
 
 #pragma once
+#include <deque>
+#include <mutex>
+
 #include "cpph/thread/locked.hxx"
 #include "cpph/utility/timer.hxx"
 #include "interfaces/RpcSessionOwner.hpp"
 #include "perfkit/extension/net/protocol.hpp"
+#include "widgets/trace/FlameGraph.hpp"
+#include "widgets/trace/Recording.hpp"
+#include "widgets/trace/SlidingStats.hpp"
+#include "widgets/trace/Snapshot.hpp"
 
 namespace proto = perfkit::net::message;
 
@@ -18,58 +25,281 @@ namespace widgets {
 class TraceWindow
 {
    private:
-    struct TraceNodeContext {
-        proto::trace_info_t info;
-        proto::trace_update_t data;
+    using TracePayload = decltype(proto::trace_update_t::payload);
 
-        vector<int> children;
+    enum ETraceNodeFlag : uint8_t {
+        // Node indices may be sparse until every node arrives.
+        TraceNode_Exists = 1 << 0,
+        TraceNode_Subscribed = 1 << 1,
+        TraceNode_Plotting = 1 << 2,
+        TraceNode_Collapsed = 1 << 3,
+        TraceNode_PendingSort = 1 << 4,
 
-        // [transient]
-        steady_clock::time_point _updateAt = {};
+        // Node matches current filter, or is an ancestor of a matching node.
+        TraceNode_FilterMatch = 1 << 5,
+        TraceNode_FilterPath = 1 << 6,
+    };
+
+    /**
+     * Nodes of a tracer in structure-of-arrays layout, indexed by node index. Update and
+     *  render loops only touch the arrays they need.
+     */
+    struct TraceNodeStore {
+        // Structure
+        vector<int> parents;
+        vector<uint32_t> nameIds;
+
+        // Children of node i are childBuffer[childOffsets[i], childOffsets[i + 1]), sorted
+        //  by index. Rebuilt from parents whenever nodes are added.
+        vector<uint32_t> childOffsets;
+        vector<int> childBuffer;
+
+        // State
+        vector<uint64_t> fences;
+        vector<TracePayload> payloads;
+        vector<uint8_t> flags;
+
+        // Statistics over recent fences, copied from RPC handler thread every tick.
+        vector<Trace::WindowSummary> stats;
+
+        // Plot slots of nodes which have been plotted. Sparse, as only a few are plotted.
+        unordered_map<int, TimePlotSlotProxy> plots;
 
-        // for plotting ...
-        TimePlotSlotProxy _hPlot;
+        // Recent numeric samples of subscribed nodes. Each node owns a ring of
+        //  HISTORY_LENGTH samples in historyPool, which grows by blocks of rings and
+        //  recycles rings of released nodes.
+        static constexpr uint32_t HISTORY_LENGTH = 64;
+        static constexpr uint32_t HISTORY_BLOCK = 32;
 
-        // Flags
-        bool _bCildrenListPendingSort : 1;
-        bool _bPlotting               : 1;
+        vector<int> historySlots;        // Node index -> ring slot, or -1
+        vector<uint32_t> historyCounts;  // Ring slot -> number of samples ever pushed
+        vector<float> historyPool;
+        vector<int> historyFreeSlots;
+
+       public:
+        size_t Size() const noexcept { return parents.size(); }
+        bool Exists(size_t index) const noexcept { return index < Size() && (flags[index] & TraceNode_Exists); }
+        bool Test(int index, uint8_t flag) const noexcept { return flags[index] & flag; }
+        void Set(int index, uint8_t flag, bool value) noexcept { value ? flags[index] |= flag : flags[index] &= ~flag; }
+
+        auto Children(int index) const noexcept
+        {
+            return make_pair(childBuffer.data() + childOffsets[index], childBuffer.data() + childOffsets[index + 1]);
+        }
+
+        bool HasChildren(int index) const noexcept { return childOffsets[index] != childOffsets[index + 1]; }
+
+        void Resize(size_t size);
+        void RebuildChildren();
+
+        void PushHistory(int index, float value);
+        void ReleaseHistory(int index);
+
+        //! Ring of given node and number of samples ever pushed. Oldest sample is at
+        //!  (count % HISTORY_LENGTH) once the ring is full.
+        auto History(int index) const noexcept -> pair<float const*, uint32_t>;
+    };
+
+    /**
+     * Lowercase full path of each node, e.g. `frame.update.physics`, with postings of
+     *  every trigram in them. Substring queries only verify nodes listed in the shortest
+     *  posting of query trigrams, instead of scanning all paths.
+     */
+    struct TraceNameIndex {
+        vector<string> paths;
+
+        // Offset of node's own name in its path
+        vector<uint32_t> nameOffsets;
+
+        // Gram of up to 3 characters -> node indices in ascending order
+        unordered_map<uint32_t, vector<int>> postings;
+
+       public:
+        //! Parent must have been added before its children, if exists.
+        void Add(int index, int parent, string_view name);
+
+        //! Nodes whose own name overlaps an occurrence of given lowercase query.
+        void Query(string_view query, vector<int>* out) const;
+    };
+
+    struct TraceRow {
+        int nodeIndex;
+        int depth;
+    };
+
+    // Fence laid out as flame graph. Layout is null until background job finishes.
+    struct FlameFrame {
+        uint64_t fence = 0;
+        shared_ptr<Trace::FlameLayout const> layout;
+    };
+
+    // Snapshots are held to keep paths of rows alive.
+    struct SnapshotDiff {
+        shared_ptr<Trace::Snapshot const> base;
+        shared_ptr<Trace::Snapshot const> target;
+        vector<Trace::SnapshotDiffRow> rows;
     };
 
     struct TracerContext {
         proto::tracer_descriptor_t info;
-        vector<unique_ptr<TraceNodeContext>> nodes;
+        TraceNodeStore nodes;
 
         // Index of root nodes
         vector<int> rootNodeIndices;
 
+        // Name index for filtering, and nodes flagged by current filter.
+        TraceNameIndex nameIndex;
+        vector<int> _filterMarked;
+        bool _bFilterDirty = false;
+
         // [state]
         uint64_t _fencePrev = 0;
         float _updateGap = 0;
         uint64_t fence = 0;
 
         // [timers]
-        poll_timer tmNextPublish{100ms};
+        // Base interval of update requests, as configured by user. Actual interval is
+        //  multiplied by _pollBackoff, which grows while the fence stays still.
+        steady_clock::duration pollInterval = 100ms;
+        float _pollBackoff = 1;
+        steady_clock::time_point _nextPollAt = {};
+
+        // Request in flight, if _waitExpiry is set. Round trip is smoothed over responses.
+        steady_clock::time_point _requestSentAt = {};
         steady_clock::time_point _waitExpiry = {};
+        steady_clock::duration _roundTrip = {};
+
         stopwatch _tmActualDeltaUpdate;
         float _actualDeltaUpdateSec = 0;
 
         // [transient]
         bool bIsTracingCached = false;
+
+        // Expanded tree flattened in display order. Rebuilt only when tree structure or
+        //  open state of any node changes, thus rows can be clipped to visible range.
+        vector<TraceRow> _rows;
+        bool _bRowsDirty = true;
+
+        // [flame graph]
+        // Recent fences in ascending order, captured only while the view is open.
+        bool bShowFlame = false;
+        std::deque<FlameFrame> _flameFrames;
+
+        // Fence being scrubbed, or 0 to follow latest. Shown layout is kept until the
+        //  layout of the next fence arrives, to prevent flickering.
+        uint64_t _flameFence = 0;
+        shared_ptr<Trace::FlameLayout const> _flameShown;
+
+        // [recording]
+        // Base path of latest recording.
+        string recordPath;
+        bool bRecording = false;
+        bool _bRecordTemporary = false;
+
+        // While replaying, rows show the state at the replayed record, indexed like nodes.
+        //  Live updates keep being applied to nodes, and subscription is left as is.
+        unique_ptr<Trace::RecordReader> _replay;
+        size_t _replayPosition = 0;
+        uint64_t _replayFence = 0;
+        vector<uint64_t> _replayFences;
+        vector<TracePayload> _replayPayloads;
     };
 
+    // Requests awaiting response are capped per session, thus a slow peer isn't flooded
+    //  as the number of tracers grows. Requests of active tracers are capped further by
+    //  twice the number that measured round trips keep busy at current poll rates.
+    static constexpr size_t MAX_IN_FLIGHT_REQUESTS = 16;
+    static constexpr float MAX_POLL_BACKOFF = 16;
+    static constexpr size_t MAX_FLAME_FRAMES = 120;
+
+    // Node indices come from the peer. Updates beyond this are dropped on arrival, as they
+    //  index per-node tables directly.
+    static constexpr uint64_t MAX_NODE_INDEX = 1 << 24;
+
    private:
     IRpcSessionOwner* _host;
     vector<TracerContext> _tracers;
 
+    // Tracer to start next poll round from, so capped requests are shared fairly.
+    size_t _pollCursor = 0;
+
+    // Tracer id -> index of _tracers. Rebuilt whenever _tracers is reordered.
+    unordered_map<uint64_t, size_t> _tracerIndices;
+
     // [transient]
     steady_clock::time_point _cachedTpNow;
     string _reusedStringBuilder;
+    vector<int> _reusedIndices;
+
+    // Filter applied to nodes of every tracer, in lowercase.
+    char _filterBuf[256] = {};
+    string _filter;
+
+    // Node names interned over all tracers, as same scope names repeat a lot.
+    vector<string> _names;
+    unordered_map<string, uint32_t> _nameIds;
+
+    // Statistics of numeric nodes over recent fences. Every update is accumulated on RPC
+    //  handler thread, and only summaries of changed nodes are copied to main thread.
+    struct StatsWindow {
+        Trace::SlidingWindowStats stats;
+        bool bDirty = false;
+    };
+
+    struct StatsTable {
+        unordered_map<int, StatsWindow> windows;
+        vector<int> dirty;
+    };
+
+    std::mutex _statsLock;
+    map<uint64_t, StatsTable> _stats;
+    bool _bShowStats = false;
+
+    // Recorders of tracers, which are written from RPC handler thread.
+    std::mutex _recordLock;
+    map<uint64_t, unique_ptr<Trace::RecordWriter>> _recorders;
+    vector<Trace::RecordEntry> _recordBuffer;
+
+    // Created on first recording if no directory is configured; removed with this window.
+    std::filesystem::path _recordTempDir;
+
+    // Snapshots to compare are shared over all sessions; see SnapshotRegistry().
+    shared_ptr<Trace::Snapshot const> _diffBase;
+    shared_ptr<Trace::Snapshot const> _diffTarget;
+    shared_ptr<SnapshotDiff const> _diff;
+    bool _bDiffPending = false;
+
+    // Plot slots of nodes being plotted, keyed by (tracer id, node index). Samples are
+    //  committed from RPC handler thread directly, without main thread round trip.
+    std::mutex _plotSinkLock;
+    map<pair<uint64_t, uint64_t>, TimePlotSlotProxy> _plotSinks;
+
+    // Updates received on RPC handler thread, coalesced by node index until main thread
+    //  applies them on next tick. Only the latest update of each node is kept, as every
+    //  sample of plotted nodes is already committed on RPC handler thread.
+    struct StagedUpdates {
+        vector<proto::trace_update_t> updates;
+
+        // Node index -> index of updates, or -1
+        vector<int> slotOf;
+
+        // Batches received since last apply, including empty ones.
+        size_t numBatches = 0;
+    };
+
+    std::mutex _stagingLock;
+    map<uint64_t, StagedUpdates> _staging;
+
+    // Swapped with _staging on main thread. Kept to reuse buffers.
+    map<uint64_t, StagedUpdates> _stagingApply;
 
    public:
     explicit TraceWindow(IRpcSessionOwner* host) : _host(host)
     {
     }
 
+    ~TraceWindow();
+
    public:
     void BuildService(rpc::service_builder&);
     void Tick();
@@ -80,10 +310,33 @@ class TraceWindow
     void _fnOnValidateTracer(vector<uint64_t>& tracer_id);
     void _fnOnNewTraceNode(uint64_t, vector<proto::trace_info_t>&);
     void _fnOnTraceUpdate(uint64_t, vector<proto::trace_update_t>&);
+    void _applyStagedUpdates();
+    void _applyTraceUpdates(TracerContext*, vector<proto::trace_update_t>&);
+    void _applyStatsUpdates();
+    void _publishUpdateRequests();
+    void _schedulePoll(TracerContext*, bool bFenceAdvanced);
+    static auto _pollIntervalOf(TracerContext const*) -> steady_clock::duration;
 
    private:
     size_t _findTracerIndex(uint64_t id) const;
+    void _rebuildTracerIndices();
     auto _findTracer(uint64_t id) -> TracerContext*;
-    void _recurseRootTraceNode(TracerContext*, TraceNodeContext*);
+    uint32_t _internName(string const&);
+    void _applyFilter(TracerContext*);
+    void _rebuildTraceRows(TracerContext*);
+    void _drawTraceNodeRow(TracerContext*, int index, int depth);
+    void _captureFlameFrame(TracerContext*);
+    void _drawFlameGraph(TracerContext*);
+    void _takeSnapshot(TracerContext*);
+    void _requestSnapshotDiff();
+    void _drawSnapshotDiff();
+    auto _recordDirectory(bool* bTemporary) -> std::filesystem::path;
+    void _setRecording(TracerContext*, bool bEnable);
+    void _setReplaying(TracerContext*, bool bEnable);
+    void _seekReplay(TracerContext*, size_t record);
+    void _drawReplayControl(TracerContext*);
+    void _setPlotSink(TracerContext*, int index, bool bEnable);
+    void _stopPlotting(TracerContext*, int index);
+    void _erasePlotSinks(uint64_t tracerId);
 };
 }  // namespace widgets
@@ -0,0 +1,162 @@
+//
+// Created by ki608 on 2022-07-31.
+//
+
+#include "Archive.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+using std::chrono::duration_cast;
+using std::chrono::steady_clock;
+using std::chrono::system_clock;
+
+// Offset to add to steady clock time to get system clock time
+steady_clock::duration SteadyToSystem()
+{
+    auto sys = duration_cast<steady_clock::duration>(system_clock::now().time_since_epoch());
+    return sys - steady_clock::now().time_since_epoch();
+}
+
+// Guards allocation against corrupted length fields.
+constexpr uint32_t MAX_NAME_LENGTH = 1 << 16;
+constexpr uint32_t MAX_CHUNK_BYTES = TimePlot::Archive::CHUNK_SIZE * 32;
+}  // namespace
+
+bool TimePlot::ArchiveWriter::Open(std::filesystem::path const& path, EValueCodec codec)
+{
+    _file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (not _file.is_open()) { return false; }
+
+    _codec = codec;
+    _toSystem = SteadyToSystem();
+    _numBytes = 0;
+
+    _write(Archive::MAGIC, sizeof Archive::MAGIC);
+    return _file.good();
+}
+
+void TimePlot::ArchiveWriter::BeginSlot(std::string_view name, float const (&color)[4])
+{
+    auto length = uint32_t(std::min<size_t>(name.size(), MAX_NAME_LENGTH));
+    _write(&length, sizeof length);
+    _write(name.data(), length);
+    _write(color, sizeof color);
+}
+
+void TimePlot::ArchiveWriter::Append(Point const& pt)
+{
+    _buffer.push_back({pt.timestamp + _toSystem, pt.value});
+    if (_buffer.size() >= Archive::CHUNK_SIZE) { _flush(); }
+}
+
+void TimePlot::ArchiveWriter::EndSlot()
+{
+    _flush();
+
+    uint32_t terminator = 0;
+    _write(&terminator, sizeof terminator);
+}
+
+bool TimePlot::ArchiveWriter::Close()
+{
+    _file.flush();
+    bool bGood = _file.good();
+
+    _file.close();
+    return bGood;
+}
+
+void TimePlot::ArchiveWriter::_flush()
+{
+    if (_buffer.empty()) { return; }
+
+    _encoded.clear();
+    EncodeBlock(_buffer.data(), _buffer.size(), _codec, &_encoded);
+    _buffer.clear();
+
+    auto numBytes = uint32_t(_encoded.size());
+    _write(&numBytes, sizeof numBytes);
+    _write(_encoded.data(), _encoded.size());
+}
+
+void TimePlot::ArchiveWriter::_write(void const* data, size_t size)
+{
+    _file.write((char const*)data, std::streamsize(size));
+    _numBytes += size;
+}
+
+bool TimePlot::ArchiveReader::Open(std::filesystem::path const& path)
+{
+    _file.open(path, std::ios::in | std::ios::binary);
+    if (not _file.is_open()) { return false; }
+
+    _fromSystem = -SteadyToSystem();
+
+    char magic[sizeof Archive::MAGIC];
+    if (not _read(magic, sizeof magic) || memcmp(magic, Archive::MAGIC, sizeof magic) != 0) {
+        return _setMalformed();
+    }
+
+    return true;
+}
+
+bool TimePlot::ArchiveReader::NextSlot(std::string* name, float (&color)[4])
+{
+    // Skip rest of current slot
+    for (std::vector<Point> discard; _bInSlot && not _bMalformed; discard.clear()) { NextChunk(&discard); }
+
+    uint32_t length;
+    if (_bMalformed || not _file.read((char*)&length, sizeof length)) { return false; }
+
+    if (length > MAX_NAME_LENGTH) { return _setMalformed(); }
+    name->resize(length);
+
+    if (not _read(name->data(), length) || not _read(color, sizeof color)) { return false; }
+
+    _bInSlot = true;
+    return true;
+}
+
+bool TimePlot::ArchiveReader::NextChunk(std::vector<Point>* out)
+{
+    if (not _bInSlot || _bMalformed) { return false; }
+
+    uint32_t numBytes;
+    if (not _read(&numBytes, sizeof numBytes)) { return false; }
+
+    if (numBytes == 0) { return _bInSlot = false; }
+    if (numBytes > MAX_CHUNK_BYTES) { return _setMalformed(); }
+
+    _encoded.resize(numBytes);
+    if (not _read(_encoded.data(), numBytes)) { return false; }
+
+    auto offset = out->size();
+    if (not DecodeBlock(_encoded.data(), _encoded.size(), out)) {
+        out->resize(offset);
+        return _setMalformed();
+    }
+
+    for (auto iter = out->begin() + offset; iter != out->end(); ++iter) {
+        iter->timestamp += _fromSystem;
+    }
+
+    return true;
+}
+
+bool TimePlot::ArchiveReader::_read(void* data, size_t size)
+{
+    if (_file.read((char*)data, std::streamsize(size))) { return true; }
+
+    // Truncated in middle of a record
+    return _setMalformed();
+}
+
+bool TimePlot::ArchiveReader::_setMalformed()
+{
+    // Nothing can be read after a malformed record, including rest of current slot.
+    _bMalformed = true;
+    _bInSlot = false;
+    return false;
+}
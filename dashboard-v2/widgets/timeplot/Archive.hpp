@@ -0,0 +1,88 @@
+//
+// Created by ki608 on 2022-07-31.
+//
+
+#pragma once
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "widgets/timeplot/Codec.hpp"
+#include "widgets/timeplot/Point.hpp"
+
+namespace TimePlot {
+/**
+ * Plot archive file, which stores samples of multiple slots in compressed chunks.
+ *
+ *      file    := MAGIC slot*
+ *      slot    := u32 nameLength, name, f32 color[4], chunk*, u32 0
+ *      chunk   := u32 numBytes, EncodeBlock() of up to CHUNK_SIZE samples
+ *
+ * Timestamps are stored as system clock ticks, as steady clock doesn't survive the
+ *  session. Both writer and reader keep at most a chunk in memory.
+ */
+namespace Archive {
+constexpr char MAGIC[8] = {'P', 'K', 'P', 'L', 'O', 'T', '0', '1'};
+constexpr size_t CHUNK_SIZE = 1 << 16;
+}  // namespace Archive
+
+class ArchiveWriter
+{
+    std::ofstream _file;
+    EValueCodec _codec = EValueCodec::Xor;
+
+    // Maps steady clock to system clock
+    steady_clock::duration _toSystem = {};
+
+    std::vector<Point> _buffer;
+    std::vector<uint8_t> _encoded;
+    size_t _numBytes = 0;
+
+   public:
+    bool Open(std::filesystem::path const& path, EValueCodec codec);
+
+    void BeginSlot(std::string_view name, float const (&color)[4]);
+    void Append(Point const& pt);
+    void EndSlot();
+
+    //! @return false if any write has failed.
+    bool Close();
+
+    //! Bytes written so far
+    size_t NumBytes() const noexcept { return _numBytes; }
+
+   private:
+    void _flush();
+    void _write(void const* data, size_t size);
+};
+
+class ArchiveReader
+{
+    std::ifstream _file;
+    steady_clock::duration _fromSystem = {};
+
+    std::vector<uint8_t> _encoded;
+    bool _bInSlot = false;
+    bool _bMalformed = false;
+
+   public:
+    //! @return false if file can't be opened or is not an archive.
+    bool Open(std::filesystem::path const& path);
+
+    //! @return false on end of file, or if the file is malformed.
+    bool NextSlot(std::string* name, float (&color)[4]);
+
+    //! Decoded samples are appended to `out`. @return false on end of slot.
+    bool NextChunk(std::vector<Point>* out);
+
+    bool Malformed() const noexcept { return _bMalformed; }
+
+   private:
+    bool _read(void* data, size_t size);
+
+    //! Always returns false, to be returned by callers.
+    bool _setMalformed();
+};
+}  // namespace TimePlot
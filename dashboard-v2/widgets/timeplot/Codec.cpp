@@ -0,0 +1,275 @@
+//
+// Created by ki608 on 2022-07-27.
+//
+
+#include "Codec.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace {
+class BitWriter
+{
+    std::vector<uint8_t>* _out;
+    uint64_t _acc = 0;
+    int _numAcc = 0;
+
+   public:
+    explicit BitWriter(std::vector<uint8_t>* out) : _out(out) {}
+
+    //! Writes lower `n` bits of `bits`, MSB first. `n` must be within [0, 64].
+    void Write(uint64_t bits, int n)
+    {
+        if (n == 0) { return; }
+        if (n < 64) { bits &= (uint64_t(1) << n) - 1; }
+
+        // Split to keep accumulator from overflow
+        if (n > 32) {
+            Write(bits >> 32, n - 32);
+            bits &= 0xffff'ffff, n = 32;
+        }
+
+        _acc = (_acc << n) | bits;
+        _numAcc += n;
+
+        while (_numAcc >= 8) {
+            _numAcc -= 8;
+            _out->push_back(uint8_t(_acc >> _numAcc));
+        }
+    }
+
+    void Flush()
+    {
+        if (_numAcc > 0) { _out->push_back(uint8_t(_acc << (8 - _numAcc))); }
+        _acc = 0, _numAcc = 0;
+    }
+};
+
+class BitReader
+{
+    uint8_t const* _data;
+    size_t _size;
+    size_t _bitPos = 0;
+
+   public:
+    BitReader(uint8_t const* data, size_t size) : _data(data), _size(size) {}
+
+    bool Good(int n) const noexcept { return _bitPos + n <= _size * 8; }
+
+    uint64_t Read(int n) noexcept
+    {
+        uint64_t value = 0;
+
+        while (n > 0) {
+            auto byte = _data[_bitPos / 8];
+            int offset = int(_bitPos % 8);
+            int take = std::min(8 - offset, n);
+
+            value = (value << take) | ((byte >> (8 - offset - take)) & ((1u << take) - 1));
+            _bitPos += take, n -= take;
+        }
+
+        return value;
+    }
+};
+
+int CountLeadingZeros(uint64_t x) noexcept
+{
+    int n = 0;
+    for (int shift = 32; shift > 0; shift >>= 1)
+        if ((x >> (64 - shift)) == 0) { n += shift, x <<= shift; }
+
+    return n + int(x == 0);
+}
+
+int CountTrailingZeros(uint64_t x) noexcept
+{
+    if (x == 0) { return 64; }
+
+    int n = 0;
+    for (int shift = 32; shift > 0; shift >>= 1)
+        if ((x & ((uint64_t(1) << shift) - 1)) == 0) { n += shift, x >>= shift; }
+
+    return n;
+}
+
+uint64_t ZigZag(int64_t v) noexcept { return (uint64_t(v) << 1) ^ uint64_t(v >> 63); }
+int64_t UnZigZag(uint64_t v) noexcept { return int64_t(v >> 1) ^ -int64_t(v & 1); }
+
+uint64_t BitsOf(double v) noexcept
+{
+    uint64_t r;
+    memcpy(&r, &v, sizeof r);
+    return r;
+}
+
+double DoubleOf(uint64_t v) noexcept
+{
+    double r;
+    memcpy(&r, &v, sizeof r);
+    return r;
+}
+
+// Delta-of-delta buckets: prefix of N ones terminated by zero selects bit width.
+//  Steady clock ticks in nanoseconds, thus even jittery periodic samples hit narrow ones.
+constexpr int DOD_WIDTHS[] = {0, 14, 24, 34, 64};
+constexpr int NUM_DOD_WIDTHS = std::size(DOD_WIDTHS);
+
+constexpr int HEADER_BITS = 32 + 8;
+
+// Unchanged timestamp delta and value, which is the smallest encoding of a sample.
+constexpr size_t MIN_SAMPLE_BITS = 2;
+}  // namespace
+
+void TimePlot::EncodeBlock(Point const* samples, size_t count, EValueCodec codec, std::vector<uint8_t>* out)
+{
+    BitWriter w{out};
+    w.Write(count, 32);
+    w.Write(uint64_t(codec), 8);
+
+    int64_t prevTime = 0, prevDelta = 0;
+    uint64_t prevBits = 0;
+    int prevLeading = -1, prevTrailing = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        auto& pt = samples[i];
+
+        // Timestamp
+        auto time = int64_t(pt.timestamp.time_since_epoch().count());
+
+        if (i == 0) {
+            w.Write(uint64_t(time), 64);
+        } else {
+            auto delta = time - prevTime;
+            auto zz = ZigZag(delta - prevDelta);
+            prevDelta = delta;
+
+            int bucket = 0;
+            while (bucket < NUM_DOD_WIDTHS - 1 && DOD_WIDTHS[bucket] < 64 && (zz >> DOD_WIDTHS[bucket]) != 0)
+                ++bucket;
+
+            w.Write(~uint64_t(0), bucket);
+            if (bucket < NUM_DOD_WIDTHS - 1) { w.Write(0, 1); }
+            w.Write(zz, DOD_WIDTHS[bucket]);
+        }
+
+        prevTime = time;
+
+        // Value
+        if (codec == EValueCodec::Float32) {
+            auto f = float(pt.value);
+            uint32_t bits;
+            memcpy(&bits, &f, sizeof bits);
+            w.Write(bits, 32);
+        } else if (codec != EValueCodec::Xor || i == 0) {
+            w.Write(prevBits = BitsOf(pt.value), 64);
+        } else {
+            auto bits = BitsOf(pt.value);
+            auto x = bits ^ prevBits;
+            prevBits = bits;
+
+            if (x == 0) {
+                w.Write(0, 1);
+                continue;
+            }
+
+            int leading = std::min(CountLeadingZeros(x), 31);
+            int trailing = CountTrailingZeros(x);
+
+            if (prevLeading >= 0 && leading >= prevLeading && trailing >= prevTrailing) {
+                // Fits in previous meaningful bits window
+                w.Write(0b10, 2);
+                w.Write(x >> prevTrailing, 64 - prevLeading - prevTrailing);
+            } else {
+                int length = 64 - leading - trailing;
+                w.Write(0b11, 2);
+                w.Write(leading, 5);
+                w.Write(length - 1, 6);
+                w.Write(x >> trailing, length);
+
+                prevLeading = leading, prevTrailing = trailing;
+            }
+        }
+    }
+
+    w.Flush();
+}
+
+bool TimePlot::DecodeBlock(uint8_t const* data, size_t size, std::vector<Point>* out)
+{
+    BitReader r{data, size};
+    if (not r.Good(HEADER_BITS)) { return false; }
+
+    auto count = size_t(r.Read(32));
+    auto codec = EValueCodec(r.Read(8));
+    if (codec < EValueCodec::Raw64 || codec >= EValueCodec::_Count) { return false; }
+
+    // Count comes from untrusted input. Every sample takes at least MIN_SAMPLE_BITS, thus
+    //  reject counts the block can't hold before reserving for them.
+    if (count > (size * 8 - HEADER_BITS) / MIN_SAMPLE_BITS) { return false; }
+
+    out->reserve(out->size() + count);
+
+    int64_t time = 0, delta = 0;
+    uint64_t bits = 0;
+    int leading = -1, trailing = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        // Timestamp
+        if (i == 0) {
+            if (not r.Good(64)) { return false; }
+            time = int64_t(r.Read(64));
+        } else {
+            int bucket = 0;
+            for (; bucket < NUM_DOD_WIDTHS - 1; ++bucket) {
+                if (not r.Good(1)) { return false; }
+                if (r.Read(1) == 0) { break; }
+            }
+
+            if (not r.Good(DOD_WIDTHS[bucket])) { return false; }
+            delta += UnZigZag(r.Read(DOD_WIDTHS[bucket]));
+            time += delta;
+        }
+
+        // Value
+        double value;
+
+        if (codec == EValueCodec::Float32) {
+            if (not r.Good(32)) { return false; }
+
+            auto u = uint32_t(r.Read(32));
+            float f;
+            memcpy(&f, &u, sizeof f);
+            value = f;
+        } else if (codec != EValueCodec::Xor || i == 0) {
+            if (not r.Good(64)) { return false; }
+            value = DoubleOf(bits = r.Read(64));
+        } else {
+            if (not r.Good(1)) { return false; }
+
+            if (r.Read(1) != 0) {
+                if (not r.Good(1)) { return false; }
+
+                if (r.Read(1) != 0) {
+                    if (not r.Good(11)) { return false; }
+                    leading = int(r.Read(5));
+                    trailing = 64 - leading - int(r.Read(6) + 1);
+                    if (trailing < 0) { return false; }
+                } else if (leading < 0) {
+                    return false;
+                }
+
+                auto length = 64 - leading - trailing;
+                if (not r.Good(length)) { return false; }
+                bits ^= r.Read(length) << trailing;
+            }
+
+            value = DoubleOf(bits);
+        }
+
+        out->push_back(Point{steady_clock::time_point{steady_clock::duration{time}}, value});
+    }
+
+    return true;
+}
@@ -0,0 +1,56 @@
+//
+// Created by ki608 on 2022-07-27.
+//
+
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "widgets/timeplot/Point.hpp"
+
+namespace TimePlot {
+/**
+ * Value column encoding of a compressed sample block
+ */
+enum class EValueCodec : int {
+    // Raw 64-bit double. Lossless.
+    Raw64,
+
+    // Narrowed to 32-bit float. Lossy, but has fixed, predictable size.
+    Float32,
+
+    // XOR with previous value, storing only meaningful bits. Lossless, and very compact
+    //  for slowly changing or repeating values.
+    Xor,
+
+    _Count
+};
+
+inline char const* ToString(EValueCodec e) noexcept
+{
+    switch (e) {
+        case EValueCodec::Raw64: return "Raw";
+        case EValueCodec::Float32: return "Float32";
+        case EValueCodec::Xor: return "XOR";
+        default: return "?";
+    }
+}
+
+/**
+ * Encodes chronologically sorted samples into a self-describing bit stream.
+ *
+ * Timestamps are stored as delta-of-delta, thus a regularly sampled series costs only a
+ *  few bits per timestamp. Values are stored as specified by `codec`.
+ *
+ * @param out Encoded bytes are appended to here.
+ */
+void EncodeBlock(Point const* samples, size_t count, EValueCodec codec, std::vector<uint8_t>* out);
+
+/**
+ * Decodes a block encoded by EncodeBlock.
+ *
+ * @param out Decoded samples are appended to here.
+ * @return false if the block is malformed. Samples decoded until then are kept.
+ */
+bool DecodeBlock(uint8_t const* data, size_t size, std::vector<Point>* out);
+}  // namespace TimePlot
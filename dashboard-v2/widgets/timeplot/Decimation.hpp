@@ -0,0 +1,184 @@
+//
+// Created by ki608 on 2022-07-24.
+//
+
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+
+namespace TimePlot {
+/**
+ * Method to reduce visible samples into display resolution
+ */
+enum class EDecimation : int {
+    // Pick first sample of each pixel. Fastest, but drops spikes.
+    Uniform,
+
+    // Keep minimum and maximum sample of each pixel, in chronological order.
+    MinMax,
+
+    // Largest-Triangle-Three-Buckets. Preserves visual shape of the series.
+    LTTB,
+
+    _Count
+};
+
+inline char const* ToString(EDecimation e) noexcept
+{
+    switch (e) {
+        case EDecimation::Uniform: return "Uniform";
+        case EDecimation::MinMax: return "Min/Max";
+        case EDecimation::LTTB: return "LTTB";
+        default: return "?";
+    }
+}
+
+namespace detail {
+/**
+ * Pixel bucket index of given timestamp. Buckets are aligned to clock epoch, instead of
+ *  visible range, to keep bucket boundaries stable while the view pans.
+ */
+template <typename TimePoint_, typename Duration_>
+int64_t BucketIndexOf(TimePoint_ const& tp, Duration_ const& width) noexcept
+{
+    auto ticks = tp.time_since_epoch().count();
+    auto w = width.count();
+    return ticks >= 0 ? ticks / w : (ticks - w + 1) / w;
+}
+
+template <typename TimePoint_>
+auto BucketWidthOf(TimePoint_ xmin, TimePoint_ xmax, size_t numPixels)
+{
+    auto width = (xmax - xmin) / int64_t(std::max<size_t>(numPixels, 1));
+    return std::max(width, decltype(width){1});
+}
+}  // namespace detail
+
+/**
+ * Picks first sample of each pixel bucket.
+ *
+ * @param begin,end Visible samples, sorted by timestamp
+ * @param sink Invoked as sink(point) for each selected sample, in chronological order.
+ */
+template <typename Iter_, typename TimePoint_, typename Sink_>
+void DecimateUniform(Iter_ begin, Iter_ end, TimePoint_ xmin, TimePoint_ xmax, size_t numPixels, Sink_&& sink)
+{
+    auto const width = detail::BucketWidthOf(xmin, xmax, numPixels);
+    int64_t bucketPrev = INT64_MIN;
+
+    for (; begin != end; ++begin) {
+        auto bucket = detail::BucketIndexOf(begin->timestamp, width);
+        if (bucket == bucketPrev) { continue; }
+
+        bucketPrev = bucket;
+        sink(*begin);
+    }
+}
+
+/**
+ * Keeps minimum and maximum sample of each pixel bucket, which preserves outliers
+ *  regardless of display resolution. Emits at most 2 samples per pixel.
+ */
+template <typename Iter_, typename TimePoint_, typename Sink_>
+void DecimateMinMax(Iter_ begin, Iter_ end, TimePoint_ xmin, TimePoint_ xmax, size_t numPixels, Sink_&& sink)
+{
+    if (begin == end) { return; }
+
+    auto const width = detail::BucketWidthOf(xmin, xmax, numPixels);
+    auto itMin = begin, itMax = begin;
+    auto bucket = detail::BucketIndexOf(begin->timestamp, width);
+
+    auto const fnFlush
+            = [&] {
+                  if (itMin == itMax) {
+                      sink(*itMin);
+                  } else if (itMin->timestamp < itMax->timestamp) {
+                      sink(*itMin), sink(*itMax);
+                  } else {
+                      sink(*itMax), sink(*itMin);
+                  }
+              };
+
+    for (auto it = std::next(begin); it != end; ++it) {
+        if (auto b = detail::BucketIndexOf(it->timestamp, width); b != bucket) {
+            fnFlush();
+            bucket = b, itMin = itMax = it;
+            continue;
+        }
+
+        if (it->value < itMin->value) { itMin = it; }
+        if (it->value > itMax->value) { itMax = it; }
+    }
+
+    fnFlush();
+}
+
+/**
+ * Largest-Triangle-Three-Buckets downsampling. First and last samples are always kept.
+ */
+template <typename Iter_, typename TimePoint_, typename Sink_>
+void DecimateLTTB(Iter_ begin, Iter_ end, TimePoint_ xmin, TimePoint_ xmax, size_t numPixels, Sink_&& sink)
+{
+    auto const numTotal = size_t(std::distance(begin, end));
+    if (numPixels < 3 || numTotal <= numPixels) {
+        for (; begin != end; ++begin) { sink(*begin); }
+        return;
+    }
+
+    // Measure x in seconds from the first sample, to keep triangle area numerically sane.
+    auto const origin = begin->timestamp;
+    auto const fnX = [origin](auto const& pt) {
+        return std::chrono::duration<double>(pt.timestamp - origin).count();
+    };
+
+    double const bucketSize = double(numTotal - 2) / double(numPixels - 2);
+    auto itSelected = begin;
+    sink(*itSelected);
+
+    for (size_t bucket = 0; bucket < numPixels - 2; ++bucket) {
+        auto const i1 = size_t(bucket * bucketSize) + 1;
+        auto const i2 = std::min(size_t((bucket + 1) * bucketSize) + 1, numTotal - 1);
+        auto const i3 = std::min(size_t((bucket + 2) * bucketSize) + 1, numTotal);
+
+        // Average of next bucket; the last bucket points to the last sample.
+        double avgX = 0, avgY = 0;
+        {
+            auto itNext = std::next(begin, i2);
+            auto const n = std::max<size_t>(i3 - i2, 1);
+            for (size_t i = 0; i < n; ++i, ++itNext) { avgX += fnX(*itNext), avgY += itNext->value; }
+            avgX /= double(n), avgY /= double(n);
+        }
+
+        double const ax = fnX(*itSelected), ay = itSelected->value;
+        double maxArea = -1;
+        auto it = std::next(begin, i1);
+        auto itPick = it;
+
+        for (auto i = i1; i < i2; ++i, ++it) {
+            double area = std::abs((ax - avgX) * (it->value - ay) - (ax - fnX(*it)) * (avgY - ay));
+            if (area > maxArea) { maxArea = area, itPick = it; }
+        }
+
+        sink(*(itSelected = itPick));
+    }
+
+    sink(*std::next(begin, numTotal - 1));
+}
+
+/**
+ * Dispatches decimation by mode.
+ */
+template <typename Iter_, typename TimePoint_, typename Sink_>
+void Decimate(EDecimation mode, Iter_ begin, Iter_ end, TimePoint_ xmin, TimePoint_ xmax, size_t numPixels, Sink_&& sink)
+{
+    switch (mode) {
+        case EDecimation::Uniform: return DecimateUniform(begin, end, xmin, xmax, numPixels, sink);
+        case EDecimation::LTTB: return DecimateLTTB(begin, end, xmin, xmax, numPixels, sink);
+        case EDecimation::MinMax:
+        default: return DecimateMinMax(begin, end, xmin, xmax, numPixels, sink);
+    }
+}
+}  // namespace TimePlot
@@ -0,0 +1,287 @@
+//
+// Created by ki608 on 2022-07-30.
+//
+
+#include "Expression.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+
+class TimePlot::Expression::Parser
+{
+    Expression* _self;
+    std::string_view _src;
+    size_t _pos = 0;
+    std::string* _error;
+
+   public:
+    Parser(Expression* self, std::string_view src, std::string* error)
+            : _self(self), _src(src), _error(error) {}
+
+    bool Run()
+    {
+        _self->_root = _expr();
+        if (_self->_root < 0) { return false; }
+
+        _skipSpace();
+        if (_pos != _src.size()) { return _fail("unexpected character"); }
+
+        return true;
+    }
+
+   private:
+    int _expr()
+    {
+        auto lhs = _term();
+
+        while (lhs >= 0) {
+            if (_consume('+'))
+                lhs = _binary(ENode::Add, lhs, _term());
+            else if (_consume('-'))
+                lhs = _binary(ENode::Subtract, lhs, _term());
+            else
+                break;
+        }
+
+        return lhs;
+    }
+
+    int _term()
+    {
+        auto lhs = _unary();
+
+        while (lhs >= 0) {
+            if (_consume('*'))
+                lhs = _binary(ENode::Multiply, lhs, _unary());
+            else if (_consume('/'))
+                lhs = _binary(ENode::Divide, lhs, _unary());
+            else
+                break;
+        }
+
+        return lhs;
+    }
+
+    int _unary()
+    {
+        if (_consume('-')) {
+            auto arg = _unary();
+            return arg < 0 ? -1 : _push({ENode::Negate, {arg, -1}});
+        }
+
+        return _primary();
+    }
+
+    int _primary()
+    {
+        _skipSpace();
+        if (_pos >= _src.size()) { return _fail("unexpected end of expression"), -1; }
+
+        if (_consume('(')) {
+            auto inner = _expr();
+            if (inner < 0) { return -1; }
+            if (not _consume(')')) { return _fail("')' expected"), -1; }
+            return inner;
+        }
+
+        if (_consume('{')) {
+            auto end = _src.find('}', _pos);
+            if (end == _src.npos) { return _fail("'}' expected"), -1; }
+
+            std::string name{_src.substr(_pos, end - _pos)};
+            _pos = end + 1;
+
+            auto& inputs = _self->_inputs;
+            auto iter = std::find(inputs.begin(), inputs.end(), name);
+            if (iter == inputs.end()) { iter = inputs.insert(inputs.end(), std::move(name)); }
+
+            Node node{ENode::Input};
+            node.param = double(iter - inputs.begin());
+            return _push(std::move(node));
+        }
+
+        if (double value; _number(&value)) {
+            Node node{ENode::Constant};
+            node.param = value;
+            return _push(std::move(node));
+        }
+
+        auto begin = _pos;
+        while (_pos < _src.size() && std::isalpha((unsigned char)_src[_pos])) { ++_pos; }
+        auto ident = _src.substr(begin, _pos - begin);
+
+        if (ident.empty()) { return _fail("unexpected character"), -1; }
+        if (not _consume('(')) { return _fail("'(' expected after function name"), -1; }
+
+        Node node;
+        if (ident == "deriv")
+            node.type = ENode::Derivative;
+        else if (ident == "ma")
+            node.type = ENode::MovingAverage;
+        else if (ident == "ewma")
+            node.type = ENode::Ewma;
+        else
+            return _fail("unknown function '" + std::string{ident} + "'"), -1;
+
+        if ((node.args[0] = _expr()) < 0) { return -1; }
+
+        if (node.type == ENode::MovingAverage) {
+            if (not _consume(',') || not _number(&node.param) || node.param < 1 || node.param > 1e6)
+                return _fail("ma() requires window size within [1, 1e6]"), -1;
+
+            node.window.resize(size_t(node.param));
+        } else if (node.type == ENode::Ewma) {
+            if (not _consume(',') || not _number(&node.param) || node.param <= 0 || node.param > 1)
+                return _fail("ewma() requires alpha within (0, 1]"), -1;
+        }
+
+        if (not _consume(')')) { return _fail("')' expected"), -1; }
+        return _push(std::move(node));
+    }
+
+    int _binary(ENode type, int lhs, int rhs)
+    {
+        if (rhs < 0) { return -1; }
+        return _push({type, {lhs, rhs}});
+    }
+
+    int _push(Node&& node)
+    {
+        auto& nodes = _self->_nodes;
+
+        if (node.type == ENode::Input) {
+            node.inputMask = InputBit(size_t(node.param));
+        } else {
+            for (auto arg : node.args)
+                if (arg >= 0) { node.inputMask |= nodes[arg].inputMask; }
+        }
+
+        _self->_nodes.push_back(std::move(node));
+        return int(_self->_nodes.size()) - 1;
+    }
+
+    bool _number(double* out)
+    {
+        _skipSpace();
+        if (_pos >= _src.size()) { return false; }
+        if (not std::isdigit((unsigned char)_src[_pos]) && _src[_pos] != '.') { return false; }
+
+        // Source is not null-terminated, thus copy digits out.
+        std::string digits;
+        for (; _pos < _src.size(); ++_pos) {
+            auto ch = _src[_pos];
+            bool bExpSign = (ch == '+' || ch == '-') && not digits.empty() && (digits.back() | 0x20) == 'e';
+            if (not std::isalnum((unsigned char)ch) && ch != '.' && not bExpSign) { break; }
+
+            digits += ch;
+        }
+
+        char* end = nullptr;
+        *out = std::strtod(digits.c_str(), &end);
+        return end == digits.c_str() + digits.size();
+    }
+
+    bool _consume(char ch)
+    {
+        _skipSpace();
+        if (_pos >= _src.size() || _src[_pos] != ch) { return false; }
+
+        ++_pos;
+        return true;
+    }
+
+    void _skipSpace()
+    {
+        while (_pos < _src.size() && std::isspace((unsigned char)_src[_pos])) { ++_pos; }
+    }
+
+    bool _fail(std::string message)
+    {
+        if (_error && _error->empty()) {
+            *_error = message + " at column " + std::to_string(_pos + 1);
+        }
+
+        return false;
+    }
+};
+
+auto TimePlot::Expression::Parse(std::string_view source, std::string* error) -> std::unique_ptr<Expression>
+{
+    auto self = std::make_unique<Expression>();
+    if (error) { error->clear(); }
+
+    if (not Parser{self.get(), source, error}.Run()) { return nullptr; }
+
+    if (self->_inputs.empty()) {
+        if (error) { *error = "expression must refer at least one slot, as {slot name}"; }
+        return nullptr;
+    }
+
+    return self;
+}
+
+double TimePlot::Expression::Evaluate(steady_clock::time_point timestamp, double const* inputs, size_t changedInput)
+{
+    return _evaluate(_root, timestamp, inputs, InputBit(changedInput));
+}
+
+double TimePlot::Expression::_evaluate(int index, steady_clock::time_point timestamp, double const* inputs, uint64_t changed)
+{
+    auto& node = _nodes[index];
+    auto const fnArg = [&](int i) { return _evaluate(node.args[i], timestamp, inputs, changed); };
+
+    switch (node.type) {
+        case ENode::Constant: return node.param;
+        case ENode::Input: return inputs[size_t(node.param)];
+        case ENode::Negate: return -fnArg(0);
+        case ENode::Add: return fnArg(0) + fnArg(1);
+        case ENode::Subtract: return fnArg(0) - fnArg(1);
+        case ENode::Multiply: return fnArg(0) * fnArg(1);
+        case ENode::Divide: return fnArg(0) / fnArg(1);
+        default: break;
+    }
+
+    // Stateful nodes; operand didn't change, thus hold the output.
+    if (not (node.inputMask & changed)) { return node.output; }
+    return node.output = _step(node, timestamp, fnArg(0));
+}
+
+double TimePlot::Expression::_step(Node& node, steady_clock::time_point timestamp, double value)
+{
+    switch (node.type) {
+        case ENode::Derivative: {
+            if (std::isnan(value)) { return NAN; }
+
+            auto prev = std::exchange(node.state, value);
+            auto prevTime = std::exchange(node.prevTime, timestamp);
+            auto dt = std::chrono::duration<double>(timestamp - prevTime).count();
+
+            if (not std::exchange(node.bHasState, true) || dt <= 0) { return NAN; }
+            return (value - prev) / dt;
+        }
+
+        case ENode::MovingAverage: {
+            if (std::isnan(value)) { return NAN; }
+
+            // `state` holds running sum, and `windowCursor` counts every sample pushed.
+            auto& window = node.window;
+            auto& slot = window[node.windowCursor++ % window.size()];
+            node.state += value - slot;
+            slot = value;
+
+            return node.state / double(std::min(node.windowCursor, window.size()));
+        }
+
+        case ENode::Ewma: {
+            if (std::isnan(value)) { return NAN; }
+
+            if (not std::exchange(node.bHasState, true)) { return node.state = value; }
+            return node.state = node.param * value + (1 - node.param) * node.state;
+        }
+
+        default: return NAN;
+    }
+}
@@ -0,0 +1,99 @@
+//
+// Created by ki608 on 2022-07-30.
+//
+
+#pragma once
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace TimePlot {
+using std::chrono::steady_clock;
+
+/**
+ * Expression which derives a series from other series.
+ *
+ * Grammar:
+ *
+ *      expr    := term (('+' | '-') term)*
+ *      term    := unary (('*' | '/') unary)*
+ *      unary   := '-' unary | primary
+ *      primary := number | '{' slot name '}' | '(' expr ')'
+ *               | 'deriv' '(' expr ')'
+ *               | 'ma' '(' expr ',' number ')'
+ *               | 'ewma' '(' expr ',' number ')'
+ *
+ * e.g. `deriv({bytes sent}) / 1024`, `ewma({hits} / ({hits} + {misses}), 0.1)`
+ *
+ * Evaluation is stateful, as deriv/ma/ewma depend on previous evaluations; thus it must be
+ *  evaluated exactly once per output sample, in chronological order. A stateful node only
+ *  advances when an input its operand refers has changed, thus e.g. `deriv({a}) + {b}`
+ *  isn't stepped by samples of `b`.
+ */
+class Expression
+{
+    enum class ENode : int {
+        Constant,
+        Input,
+        Negate,
+        Add,
+        Subtract,
+        Multiply,
+        Divide,
+        Derivative,
+        MovingAverage,
+        Ewma,
+    };
+
+    struct Node {
+        ENode type = ENode::Constant;
+        int args[2] = {-1, -1};
+        double param = 0;
+
+        // Inputs this subtree refers. Inputs from 63rd on share the last bit.
+        uint64_t inputMask = 0;
+
+        // Evaluation state of stateful nodes, and output of latest step.
+        double output = NAN;
+        double state = 0;
+        steady_clock::time_point prevTime = {};
+        bool bHasState = false;
+        std::vector<double> window;
+        size_t windowCursor = 0;
+    };
+
+   private:
+    std::vector<Node> _nodes;
+    std::vector<std::string> _inputs;
+    int _root = -1;
+
+   public:
+    /**
+     * @param error Filled with human readable message on failure.
+     * @return nullptr if given expression is malformed.
+     */
+    static auto Parse(std::string_view source, std::string* error) -> std::unique_ptr<Expression>;
+
+    //! Names of slots referred, in index order of evaluation inputs.
+    auto const& InputNames() const noexcept { return _inputs; }
+
+    /**
+     * @param inputs Latest value of each input, in order of InputNames()
+     * @param changedInput Index of input which got a new sample at this moment. Stateful
+     *  nodes not referring it hold their previous output.
+     * @return NaN if the value is not defined at this moment, e.g. first derivative sample.
+     */
+    double Evaluate(steady_clock::time_point timestamp, double const* inputs, size_t changedInput);
+
+   private:
+    class Parser;
+    double _evaluate(int index, steady_clock::time_point timestamp, double const* inputs, uint64_t changed);
+    static double _step(Node& node, steady_clock::time_point timestamp, double value);
+
+    static uint64_t InputBit(size_t input) noexcept { return uint64_t(1) << std::min<size_t>(input, 63); }
+};
+}  // namespace TimePlot
@@ -0,0 +1,247 @@
+//
+// Created by ki608 on 2022-07-28.
+//
+
+#include "LineRenderer.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+#include "GL/gl3w.h"
+#include "implot.h"
+#include "spdlog/spdlog.h"
+
+namespace {
+#if defined(__APPLE__)
+#    define GLSL_VERSION "#version 150\n"
+#else
+#    define GLSL_VERSION "#version 130\n"
+#endif
+
+char const* const VERTEX_SHADER
+        = GLSL_VERSION
+        R"(
+// Every instance is a segment between consecutive vertices, expanded to a quad of
+//  line weight. Quads are extended by half weight at both ends to cover joints.
+in vec2 aFrom;
+in vec2 aTo;
+uniform vec2 uScale;
+uniform vec2 uOffset;
+uniform vec4 uDisplay;  // xy: display position, zw: display size
+uniform float uHalfWeight;
+
+void main()
+{
+    vec2 from = uOffset + uScale * aFrom;
+    vec2 to = uOffset + uScale * aTo;
+
+    vec2 dir = to - from;
+    float len = length(dir);
+    dir = len > 0.0 ? dir / len : vec2(1.0, 0.0);
+    vec2 normal = vec2(-dir.y, dir.x);
+
+    // Triangle strip order: from-left, from-right, to-left, to-right
+    vec2 pixel = gl_VertexID < 2 ? from - dir * uHalfWeight : to + dir * uHalfWeight;
+    pixel += normal * ((gl_VertexID & 1) == 0 ? uHalfWeight : -uHalfWeight);
+
+    vec2 ndc = (pixel - uDisplay.xy) / uDisplay.zw * 2.0 - 1.0;
+    gl_Position = vec4(ndc.x, -ndc.y, 0, 1);
+}
+)";
+
+char const* const FRAGMENT_SHADER
+        = GLSL_VERSION
+        R"(
+uniform vec4 uColor;
+out vec4 outColor;
+
+void main()
+{
+    outColor = uColor;
+}
+)";
+
+GLuint CompileShader(GLenum type, char const* source)
+{
+    auto shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+
+    GLint status = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status == GL_TRUE) { return shader; }
+
+    char log[512] = {};
+    glGetShaderInfoLog(shader, sizeof log, nullptr, log);
+    spdlog::warn("Failed to compile plot line shader: {}", log);
+
+    glDeleteShader(shader);
+    return 0;
+}
+
+struct LineProgram {
+    bool bInitTried = false;
+    GLuint program = 0;
+
+    GLint uScale = -1;
+    GLint uOffset = -1;
+    GLint uColor = -1;
+    GLint uDisplay = -1;
+    GLint uHalfWeight = -1;
+} gProgram;
+}  // namespace
+
+TimePlot::LineRenderer::~LineRenderer()
+{
+    if (_vbo) { glDeleteBuffers(1, &_vbo); }
+}
+
+bool TimePlot::LineRenderer::Available()
+{
+    auto& g = gProgram;
+    if (std::exchange(g.bInitTried, true)) { return g.program != 0; }
+    if (gl3wInit() != GL3W_OK) {
+        spdlog::warn("Failed to load OpenGL functions; plots fall back to CPU rendering");
+        return false;
+    }
+
+    // Segments are drawn as instances, which requires OpenGL 3.3.
+    if (not glVertexAttribDivisor || not glDrawArraysInstanced) {
+        spdlog::warn("Instanced drawing is not supported; plots fall back to CPU rendering");
+        return false;
+    }
+
+    auto vs = CompileShader(GL_VERTEX_SHADER, VERTEX_SHADER);
+    auto fs = CompileShader(GL_FRAGMENT_SHADER, FRAGMENT_SHADER);
+
+    if (vs && fs) {
+        g.program = glCreateProgram();
+        glAttachShader(g.program, vs);
+        glAttachShader(g.program, fs);
+        glBindAttribLocation(g.program, 0, "aFrom");
+        glBindAttribLocation(g.program, 1, "aTo");
+        glLinkProgram(g.program);
+
+        GLint status = 0;
+        glGetProgramiv(g.program, GL_LINK_STATUS, &status);
+
+        if (status != GL_TRUE) {
+            spdlog::warn("Failed to link plot line shader; plots fall back to CPU rendering");
+            glDeleteProgram(g.program);
+            g.program = 0;
+        }
+    }
+
+    if (vs) { glDeleteShader(vs); }
+    if (fs) { glDeleteShader(fs); }
+    if (g.program == 0) { return false; }
+
+    g.uScale = glGetUniformLocation(g.program, "uScale");
+    g.uOffset = glGetUniformLocation(g.program, "uOffset");
+    g.uColor = glGetUniformLocation(g.program, "uColor");
+    g.uDisplay = glGetUniformLocation(g.program, "uDisplay");
+    g.uHalfWeight = glGetUniformLocation(g.program, "uHalfWeight");
+    return true;
+}
+
+void TimePlot::LineRenderer::Upload(float const* xy, size_t numVertices)
+{
+    if (not Available()) { return; }
+    if (_vbo == 0) { glGenBuffers(1, &_vbo); }
+
+    GLint prevBuffer = 0;
+    glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &prevBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+
+    // Buffer storage is reallocated only when it grows.
+    auto const numBytes = numVertices * sizeof(float) * 2;
+    if (numBytes > _vboCapacity) {
+        _vboCapacity = std::max(numBytes, _vboCapacity * 2);
+        glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(_vboCapacity), nullptr, GL_DYNAMIC_DRAW);
+    }
+
+    glBufferSubData(GL_ARRAY_BUFFER, 0, GLsizeiptr(numBytes), xy);
+    glBindBuffer(GL_ARRAY_BUFFER, GLuint(prevBuffer));
+
+    _numVertices = numVertices;
+}
+
+void TimePlot::LineRenderer::Draw(size_t first, size_t count, double originX, ImVec4 const& color, float weight)
+{
+    if (count < 2 || first + count > _numVertices) { return; }
+
+    // Plot to pixel transform, which is affine for linear and time scales.
+    auto p0 = ImPlot::PlotToPixels(originX, 0);
+    auto p1 = ImPlot::PlotToPixels(originX + 1, 1);
+
+    auto viewport = ImGui::GetWindowViewport();
+
+    auto& cmd = _cmds.emplace_back();
+    cmd.owner = this;
+    cmd.first = int(first);
+    cmd.count = int(count);
+    cmd.color[0] = color.x, cmd.color[1] = color.y, cmd.color[2] = color.z, cmd.color[3] = color.w;
+    cmd.scale[0] = p1.x - p0.x, cmd.scale[1] = p1.y - p0.y;
+    cmd.offset[0] = p0.x, cmd.offset[1] = p0.y;
+    cmd.halfWeight = weight * .5f;
+    cmd.displayPos = viewport->Pos;
+    cmd.displaySize = viewport->Size;
+
+    auto drawList = ImPlot::GetPlotDrawList();
+    ImPlot::PushPlotClipRect();
+    drawList->AddCallback(&LineRenderer::_fnDrawCallback, &cmd);
+    drawList->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
+    ImPlot::PopPlotClipRect();
+}
+
+void TimePlot::LineRenderer::_fnDrawCallback(ImDrawList const* list, ImDrawCmd const* drawCmd)
+{
+    auto cmd = (DrawCmd const*)drawCmd->UserCallbackData;
+    auto self = cmd->owner;
+
+    // Backend doesn't apply clip rect to callbacks, thus apply it here. Viewport is set
+    //  to framebuffer size by backend, which gives framebuffer scale.
+    GLint viewport[4] = {};
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    auto const fbScaleX = float(viewport[2]) / cmd->displaySize.x;
+    auto const fbScaleY = float(viewport[3]) / cmd->displaySize.y;
+    auto const& clip = drawCmd->ClipRect;
+
+    ImVec2 clipMin = {(clip.x - cmd->displayPos.x) * fbScaleX, (clip.y - cmd->displayPos.y) * fbScaleY};
+    ImVec2 clipMax = {(clip.z - cmd->displayPos.x) * fbScaleX, (clip.w - cmd->displayPos.y) * fbScaleY};
+    if (clipMax.x <= clipMin.x || clipMax.y <= clipMin.y) { return; }
+
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(GLint(clipMin.x), GLint(float(viewport[3]) - clipMax.y),
+              GLsizei(clipMax.x - clipMin.x), GLsizei(clipMax.y - clipMin.y));
+
+    // Vertex array object bound by backend is reused; reset callback restores its layout.
+    auto& g = gProgram;
+    glUseProgram(g.program);
+    glUniform2fv(g.uScale, 1, cmd->scale);
+    glUniform2fv(g.uOffset, 1, cmd->offset);
+    glUniform4fv(g.uColor, 1, cmd->color);
+    glUniform4f(g.uDisplay, cmd->displayPos.x, cmd->displayPos.y, cmd->displaySize.x, cmd->displaySize.y);
+    glUniform1f(g.uHalfWeight, cmd->halfWeight);
+
+    // Both endpoints of a segment are read from the same buffer, one vertex apart.
+    auto const stride = GLsizei(sizeof(float) * 2);
+    auto const fnOffset = [&](int vertex) { return (void const*)(uintptr_t(vertex) * stride); };
+
+    glBindBuffer(GL_ARRAY_BUFFER, self->_vbo);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, fnOffset(cmd->first));
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, fnOffset(cmd->first + 1));
+    glVertexAttribDivisor(0, 1);
+    glVertexAttribDivisor(1, 1);
+
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, cmd->count - 1);
+
+    // Reset callback doesn't restore divisors, which would break backend's draws.
+    glVertexAttribDivisor(0, 0);
+    glVertexAttribDivisor(1, 0);
+    (void)list;
+}
@@ -0,0 +1,72 @@
+//
+// Created by ki608 on 2022-07-28.
+//
+
+#pragma once
+#include <deque>
+#include <vector>
+
+#include "imgui.h"
+
+namespace TimePlot {
+/**
+ * Draws line strips from a persistent OpenGL vertex buffer, in place of ImPlot's CPU
+ *  tessellation. Vertices are uploaded only when a new plot cache arrives, and every
+ *  frame only records a draw list callback per line. Each segment is expanded to a quad
+ *  of line weight by the vertex shader, drawn as an instance.
+ *
+ * Shader program is shared by every instance, while each instance owns its buffer.
+ *
+ * Must be used from main thread, with the main GL context current.
+ */
+class LineRenderer
+{
+    struct DrawCmd {
+        LineRenderer* owner;
+        int first;
+        int count;
+
+        float color[4];
+        float scale[2];
+        float offset[2];
+        float halfWeight;
+
+        ImVec2 displayPos;
+        ImVec2 displaySize;
+    };
+
+   private:
+    unsigned _vbo = 0;
+    size_t _vboCapacity = 0;
+    size_t _numVertices = 0;
+
+    // Referred by draw list callbacks until the frame is rendered.
+    std::deque<DrawCmd> _cmds;
+
+   public:
+    LineRenderer() = default;
+    LineRenderer(LineRenderer const&) = delete;
+    LineRenderer& operator=(LineRenderer const&) = delete;
+    ~LineRenderer();
+
+   public:
+    //! Compiles shader on first call. Returns false if GPU path is unavailable.
+    static bool Available();
+
+    //! Discards draw commands of previous frame.
+    void NewFrame() { _cmds.clear(); }
+
+    //! @param xy Interleaved x, y pairs of every vertex
+    void Upload(float const* xy, size_t numVertices);
+
+    /**
+     * Draws vertices [first, first + count) as a line strip on current ImPlot plot.
+     *  Uploaded x coordinates are relative to `originX`, to keep float precision.
+     * @param weight Line weight in pixels
+     */
+    void Draw(size_t first, size_t count, double originX, ImVec4 const& color, float weight);
+
+   private:
+    static void _fnDrawCallback(ImDrawList const* list, ImDrawCmd const* cmd);
+};
+}  // namespace TimePlot
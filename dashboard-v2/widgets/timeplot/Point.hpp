@@ -0,0 +1,23 @@
+//
+// Created by ki608 on 2022-07-24.
+//
+
+#pragma once
+#include <chrono>
+
+namespace TimePlot {
+using std::chrono::steady_clock;
+
+/**
+ * Indicates single dot on plot
+ */
+struct Point {
+    steady_clock::time_point timestamp = {};
+    double value = 0;
+
+    bool operator<(steady_clock::time_point const& tp) const noexcept
+    {
+        return timestamp < tp;
+    }
+};
+}  // namespace TimePlot
@@ -0,0 +1,214 @@
+//
+// Created by ki608 on 2022-07-24.
+//
+
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <utility>
+
+#include "widgets/timeplot/Decimation.hpp"
+#include "widgets/timeplot/Point.hpp"
+
+namespace TimePlot {
+/**
+ * Summary of consecutive samples
+ */
+struct Bucket {
+    // Timestamp of first/last sample within this bucket
+    steady_clock::time_point timeBegin = {};
+    steady_clock::time_point timeEnd = {};
+
+    double first = 0;
+    double min = 0;
+    double max = 0;
+    double sum = 0;
+
+    uint32_t count = 0;
+
+    // Minimum sample precedes maximum sample
+    bool bMinFirst = true;
+
+    double Mean() const noexcept { return sum / count; }
+
+    void Add(Point const& pt) noexcept
+    {
+        if (count++ == 0) {
+            timeBegin = timeEnd = pt.timestamp;
+            first = min = max = sum = pt.value;
+            bMinFirst = true;
+            return;
+        }
+
+        timeEnd = pt.timestamp;
+        sum += pt.value;
+
+        if (pt.value < min) { min = pt.value, bMinFirst = false; }
+        if (pt.value > max) { max = pt.value, bMinFirst = true; }
+    }
+
+    void Merge(Bucket const& other) noexcept
+    {
+        if (count == 0) { *this = other; return; }
+
+        bool const bOtherMin = other.min < min;
+        bool const bOtherMax = other.max > max;
+
+        // As `other` always succeeds this bucket, only mixed origin changes the order.
+        if (bOtherMin && bOtherMax)
+            bMinFirst = other.bMinFirst;
+        else if (bOtherMin || bOtherMax)
+            bMinFirst = bOtherMax;
+
+        if (bOtherMin) { min = other.min; }
+        if (bOtherMax) { max = other.max; }
+
+        timeEnd = other.timeEnd;
+        sum += other.sum;
+        count += other.count;
+    }
+
+    /**
+     * Expands this bucket into pseudo samples which the decimation of given mode can
+     *  consume in place of the original samples.
+     */
+    template <typename Sink_>
+    void Expand(EDecimation mode, Sink_&& sink) const
+    {
+        if (count == 1) {
+            sink(Point{timeBegin, first});
+        } else if (mode == EDecimation::Uniform) {
+            sink(Point{timeBegin, first});
+        } else if (mode == EDecimation::LTTB) {
+            sink(Point{timeBegin + (timeEnd - timeBegin) / 2, Mean()});
+        } else if (bMinFirst) {
+            sink(Point{timeBegin, min}), sink(Point{timeEnd, max});
+        } else {
+            sink(Point{timeBegin, max}), sink(Point{timeEnd, min});
+        }
+    }
+};
+
+/**
+ * Multi-resolution summary of a slot's sample history.
+ *
+ * Level N bucket summarizes FANOUT^N consecutive samples. Buckets are sealed as samples
+ *  are appended, and evicted along with the oldest samples, thus wide time ranges can be
+ *  served in O(pixels) regardless of history length.
+ */
+class SamplePyramid
+{
+   public:
+    static constexpr size_t FANOUT = 32;
+    static constexpr int NUM_LEVELS = 3;
+
+   private:
+    struct Level {
+        std::deque<Bucket> sealed;
+        Bucket pending;
+        size_t numPendingChild = 0;
+    };
+
+    // Index 0 indicates level 1, as raw samples are not stored here.
+    std::array<Level, NUM_LEVELS> _levels;
+
+   public:
+    void Append(Point const& pt)
+    {
+        Bucket carry;
+        carry.Add(pt);
+
+        for (auto& level : _levels) {
+            level.pending.Merge(carry);
+            if (++level.numPendingChild < FANOUT) { return; }
+
+            level.numPendingChild = 0;
+            carry = level.sealed.emplace_back(std::exchange(level.pending, {}));
+        }
+    }
+
+    template <typename Iter_>
+    void Append(Iter_ begin, Iter_ end)
+    {
+        for (; begin != end; ++begin) { Append(*begin); }
+    }
+
+    /**
+     * Discard buckets which only contain samples older than given timestamp.
+     */
+    void EvictBefore(steady_clock::time_point oldest)
+    {
+        for (auto& level : _levels) {
+            while (not level.sealed.empty() && level.sealed.front().timeEnd < oldest)
+                level.sealed.pop_front();
+        }
+    }
+
+    void Clear()
+    {
+        _levels = {};
+    }
+
+    /**
+     * Select coarsest level which still gives at least one bucket per pixel, when there are
+     *  `numVisible` raw samples. Returns 0 if raw samples should be used.
+     */
+    static int SelectLevel(size_t numVisible, size_t numPixels) noexcept
+    {
+        int level = 0;
+        for (size_t span = FANOUT; level < NUM_LEVELS && numVisible / span >= numPixels; span *= FANOUT)
+            ++level;
+
+        return level;
+    }
+
+    /**
+     * Beginning of the bucket which Collect() would expand first from given timestamp, if
+     *  it starts earlier than that. Otherwise returns the timestamp as is.
+     */
+    auto BucketBeginAt(int level, steady_clock::time_point tp) const -> steady_clock::time_point
+    {
+        for (; level > 0; --level) {
+            auto& buckets = _levels[level - 1].sealed;
+            auto iter = std::lower_bound(
+                    buckets.begin(), buckets.end(), tp,
+                    [](Bucket const& b, steady_clock::time_point tp) { return b.timeEnd < tp; });
+
+            if (iter != buckets.end()) { return std::min(tp, iter->timeBegin); }
+        }
+
+        return tp;
+    }
+
+    /**
+     * Expands sealed buckets of given level which overlap [xmin, xmax) into pseudo samples.
+     *  Range not sealed yet at given level is filled from finer levels.
+     *
+     * @return Timestamp from where raw samples should be used to complete the range.
+     */
+    template <typename Sink_>
+    auto Collect(int level, steady_clock::time_point xmin, steady_clock::time_point xmax,
+                 EDecimation mode, Sink_&& sink) const -> steady_clock::time_point
+    {
+        auto cursor = xmin;
+
+        for (; level > 0; --level) {
+            auto& buckets = _levels[level - 1].sealed;
+            auto iter = std::lower_bound(
+                    buckets.begin(), buckets.end(), cursor,
+                    [](Bucket const& b, steady_clock::time_point tp) { return b.timeEnd < tp; });
+
+            for (; iter != buckets.end() && iter->timeBegin < xmax; ++iter) {
+                iter->Expand(mode, sink);
+                cursor = iter->timeEnd + steady_clock::duration{1};
+            }
+
+            if (cursor >= xmax) { break; }
+        }
+
+        return cursor;
+    }
+};
+}  // namespace TimePlot
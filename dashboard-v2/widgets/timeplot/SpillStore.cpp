@@ -0,0 +1,179 @@
+//
+// Created by ki608 on 2022-07-26.
+//
+
+#include "SpillStore.hpp"
+
+#include <random>
+
+#include "spdlog/spdlog.h"
+
+TimePlot::SpillStore::~SpillStore()
+{
+    if (_file.is_open()) {
+        _file.close();
+
+        std::error_code ec;
+        std::filesystem::remove(_path, ec);
+    }
+}
+
+void TimePlot::SpillStore::Append(Point const& pt)
+{
+    if (Empty()) { _front = pt; }
+
+    auto& subBuckets = _open.subBuckets;
+    if (subBuckets.empty() || subBuckets.back().count == SUB_BUCKET_SIZE) {
+        subBuckets.reserve(CHUNK_SIZE / SUB_BUCKET_SIZE);
+        subBuckets.emplace_back();
+    }
+
+    subBuckets.back().Add(pt);
+    _open.summary.Add(pt);
+    _openSamples.push_back(pt);
+
+    if (_openSamples.size() == CHUNK_SIZE) {
+        _sealOpenChunk();
+    }
+}
+
+void TimePlot::SpillStore::_sealOpenChunk()
+{
+    std::vector<uint8_t> encoded;
+    EncodeBlock(_openSamples.data(), _openSamples.size(), _codec, &encoded);
+    encoded.shrink_to_fit();
+
+    _residentBytes += encoded.size();
+    _open.encoded = std::make_shared<std::vector<uint8_t> const>(std::move(encoded));
+
+    _chunks.emplace_back(std::move(_open));
+    _open = {};
+    _openSamples.clear();
+
+    _evictResidentChunks();
+}
+
+void TimePlot::SpillStore::_evictResidentChunks()
+{
+    while (_residentBytes > _residentBudget && _residentCursor < _chunks.size()) {
+        auto& chunk = _chunks[_residentCursor++];
+
+        if (_bDiskEnabled && _tryOpenFile()) {
+            _file.seekp(_fileSize);
+            _file.write((char const*)chunk.encoded->data(), std::streamsize(chunk.encoded->size()));
+
+            if (_file.good()) {
+                chunk.offset = _fileSize;
+                chunk.numBytes = chunk.encoded->size();
+                _fileSize += int64_t(chunk.numBytes);
+            } else {
+                _file.clear();
+            }
+        }
+
+        _residentBytes -= chunk.encoded->size();
+        chunk.encoded.reset();
+    }
+}
+
+auto TimePlot::SpillStore::_loadChunk(size_t index) -> std::vector<Point> const*
+{
+    for (auto iter = _cache.begin(); iter != _cache.end(); ++iter) {
+        if (iter->first == index) {
+            _cache.splice(_cache.begin(), _cache, iter);
+            return &_cache.front().second;
+        }
+    }
+
+    auto& chunk = _chunks[index];
+    if (not chunk.encoded && (chunk.offset < 0 || not _file.is_open())) { return nullptr; }
+
+    // Reuse buffer of least recently used entry
+    std::vector<Point> buffer;
+    if (_cache.size() >= NUM_CACHED_CHUNKS) {
+        buffer = std::move(_cache.back().second);
+        _cache.pop_back();
+    }
+
+    buffer.clear();
+
+    if (chunk.encoded) {
+        DecodeBlock(chunk.encoded->data(), chunk.encoded->size(), &buffer);
+    } else {
+        _readBuffer.resize(chunk.numBytes);
+        _file.seekg(chunk.offset);
+        _file.read((char*)_readBuffer.data(), std::streamsize(_readBuffer.size()));
+
+        if (not _file.good() || not DecodeBlock(_readBuffer.data(), _readBuffer.size(), &buffer)) {
+            _file.clear();
+            chunk.offset = -1;  // Don't try again.
+            return nullptr;
+        }
+    }
+
+    _cache.emplace_front(index, std::move(buffer));
+    return &_cache.front().second;
+}
+
+auto TimePlot::SpillStore::TakeSnapshot() -> Snapshot
+{
+    Snapshot snapshot;
+    snapshot._chunks.reserve(_chunks.size());
+    snapshot._openSamples = _openSamples;
+
+    for (auto& chunk : _chunks) {
+        snapshot._chunks.push_back({chunk.encoded, chunk.offset, chunk.numBytes, chunk.summary.count});
+    }
+
+    if (_file.is_open()) {
+        // Spilled chunks must be visible to the other handle.
+        _file.flush();
+        snapshot._file.open(_path, std::ios::in | std::ios::binary);
+    }
+
+    return snapshot;
+}
+
+bool TimePlot::SpillStore::Snapshot::_load(Chunk const& chunk)
+{
+    _decoded.clear();
+
+    if (chunk.encoded) {
+        return DecodeBlock(chunk.encoded->data(), chunk.encoded->size(), &_decoded);
+    }
+
+    if (chunk.offset < 0 || not _file.is_open()) { return false; }
+
+    _readBuffer.resize(chunk.numBytes);
+    _file.seekg(chunk.offset);
+    _file.read((char*)_readBuffer.data(), std::streamsize(_readBuffer.size()));
+
+    if (not _file.good()) {
+        _file.clear();
+        return false;
+    }
+
+    return DecodeBlock(_readBuffer.data(), _readBuffer.size(), &_decoded);
+}
+
+bool TimePlot::SpillStore::_tryOpenFile()
+{
+    if (_file.is_open()) { return true; }
+    if (std::exchange(_bFileOpenTried, true)) { return false; }
+
+    std::error_code ec;
+    auto dir = std::filesystem::temp_directory_path(ec);
+    if (ec) { dir = "."; }
+
+    std::random_device rd;
+    _path = dir / fmt::format("perfkit-dashboard-{:08x}{:08x}.spill", rd(), rd());
+    _file.open(_path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+
+    if (not _file.is_open()) {
+        spdlog::warn("Failed to open plot spill file '{}'", _path.string());
+        NotifyToast{LOCWORD("Plot History")}.Warning().String(LOCTEXT("Failed to create spill file; old samples will be kept as summary only."));
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,270 @@
+//
+// Created by ki608 on 2022-07-26.
+//
+
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <vector>
+
+#include "widgets/timeplot/Codec.hpp"
+#include "widgets/timeplot/Point.hpp"
+#include "widgets/timeplot/Pyramid.hpp"
+
+namespace TimePlot {
+/**
+ * Append-only compressed store for samples evicted from a slot's in-memory history.
+ *
+ * Samples are grouped into fixed-size chunks. Each chunk is compressed once it's full, and
+ *  kept in memory until resident bytes exceed the budget. Then the oldest chunks are moved
+ *  to a temporary file, or discarded if disk is disabled. Summary buckets always stay in
+ *  memory, thus wide ranges are served from summaries, and only narrow ranges decode chunk
+ *  contents.
+ *
+ * Only accessed from async cache builder, or while it's idle. Use snapshots to read it
+ *  from elsewhere.
+ */
+class SpillStore
+{
+   public:
+    static constexpr size_t CHUNK_SIZE = 1 << 16;
+    static constexpr size_t SUB_BUCKET_SIZE = 1 << 10;
+    static constexpr size_t NUM_CACHED_CHUNKS = 4;
+
+   private:
+    struct ChunkDesc {
+        // Summary of whole chunk, and of every SUB_BUCKET_SIZE samples.
+        Bucket summary;
+        std::vector<Bucket> subBuckets;
+
+        // Compressed samples. Null if the chunk is not resident anymore. Shared with
+        //  snapshots, thus never modified once sealed.
+        std::shared_ptr<std::vector<uint8_t> const> encoded;
+
+        // Offset and size in spill file. Negative if the chunk is not on disk.
+        int64_t offset = -1;
+        size_t numBytes = 0;
+    };
+
+   public:
+    /**
+     * Spilled samples as of the moment it was taken, which can be read from another thread
+     *  while the store keeps growing. Sealed chunks are never modified, thus resident
+     *  contents are shared, and spilled ones are read through a separate file handle.
+     */
+    class Snapshot
+    {
+        friend class SpillStore;
+
+        struct Chunk {
+            std::shared_ptr<std::vector<uint8_t> const> encoded;
+            int64_t offset = -1;
+            size_t numBytes = 0;
+            size_t count = 0;
+        };
+
+        std::vector<Chunk> _chunks;
+        std::vector<Point> _openSamples;
+        std::ifstream _file;
+
+        std::vector<uint8_t> _readBuffer;
+        std::vector<Point> _decoded;
+
+       public:
+        /**
+         * Emits every sample in chronological order, decoding chunks one by one.
+         *
+         * @return Number of samples skipped, as their chunks were discarded.
+         */
+        template <typename Sink_>
+        size_t ForEach(Sink_&& sink);
+
+       private:
+        bool _load(Chunk const& chunk);
+    };
+
+   private:
+    std::filesystem::path _path;
+    std::fstream _file;
+    int64_t _fileSize = 0;
+    bool _bFileOpenTried = false;
+
+    EValueCodec _codec = EValueCodec::Xor;
+    size_t _residentBudget = SIZE_MAX;
+    size_t _residentBytes = 0;
+    size_t _residentCursor = 0;
+    bool _bDiskEnabled = true;
+
+    // Sealed chunks, sorted by time.
+    std::vector<ChunkDesc> _chunks;
+
+    // Chunk being filled. Its samples are kept in memory until sealed.
+    ChunkDesc _open;
+    std::vector<Point> _openSamples;
+
+    // Recently loaded chunks, most recent first.
+    std::list<std::pair<size_t, std::vector<Point>>> _cache;
+    std::vector<uint8_t> _readBuffer;
+
+    Point _front = {};
+
+   public:
+    SpillStore() = default;
+    SpillStore(SpillStore const&) = delete;
+    SpillStore& operator=(SpillStore const&) = delete;
+    ~SpillStore();
+
+   public:
+    /**
+     * Codec is applied to chunks sealed from now on. Chunks exceeding shrunk budget are
+     *  evicted immediately.
+     */
+    void Configure(EValueCodec codec, size_t residentBudget, bool bDiskEnabled)
+    {
+        _codec = codec;
+        _residentBudget = residentBudget;
+        _bDiskEnabled = bDiskEnabled;
+
+        _evictResidentChunks();
+    }
+
+    //! Bytes of compressed samples kept in memory
+    size_t ResidentBytes() const noexcept { return _residentBytes; }
+
+    bool Empty() const noexcept { return _chunks.empty() && _openSamples.empty(); }
+
+    //! Oldest sample ever spilled.
+    Point const& Front() const noexcept { return _front; }
+
+    //! Total number of spilled samples.
+    size_t Size() const noexcept { return _chunks.size() * CHUNK_SIZE + _openSamples.size(); }
+
+    //! Samples must be appended in chronological order.
+    void Append(Point const& pt);
+
+    template <typename Iter_>
+    void Append(Iter_ begin, Iter_ end)
+    {
+        for (; begin != end; ++begin) { Append(*begin); }
+    }
+
+    /**
+     * Emits samples, or pseudo samples from summaries, which cover [xmin, xmax).
+     *
+     * If every pixel covers at least one sub bucket, their summaries are used instead of
+     *  paging chunk contents in.
+     */
+    template <typename Sink_>
+    void Collect(steady_clock::time_point xmin, steady_clock::time_point xmax,
+                 size_t numPixels, EDecimation mode, Sink_&& sink);
+
+    //! Must not be called while the store is being appended.
+    Snapshot TakeSnapshot();
+
+   private:
+    void _sealOpenChunk();
+    void _evictResidentChunks();
+    auto _loadChunk(size_t index) -> std::vector<Point> const*;
+    bool _tryOpenFile();
+};
+
+template <typename Sink_>
+void SpillStore::Collect(
+        steady_clock::time_point xmin, steady_clock::time_point xmax,
+        size_t numPixels, EDecimation mode, Sink_&& sink)
+{
+    auto cbeg = std::lower_bound(
+            _chunks.begin(), _chunks.end(), xmin,
+            [](ChunkDesc const& c, steady_clock::time_point tp) { return c.summary.timeEnd < tp; });
+    auto cend = std::lower_bound(
+            cbeg, _chunks.end(), xmax,
+            [](ChunkDesc const& c, steady_clock::time_point tp) { return c.summary.timeBegin < tp; });
+
+    bool const bOpenInRange = not _openSamples.empty()
+                              && _open.summary.timeEnd >= xmin
+                              && _open.summary.timeBegin < xmax;
+
+    // Estimate number of samples in range, in sub bucket granularity.
+    auto const fnCountInRange
+            = [&](ChunkDesc const& chunk) {
+                  size_t count = 0;
+                  for (auto& sub : chunk.subBuckets)
+                      if (sub.timeEnd >= xmin && sub.timeBegin < xmax)
+                          count += sub.count;
+
+                  return count;
+              };
+
+    size_t numInRange = bOpenInRange ? fnCountInRange(_open) : 0;
+    if (cend - cbeg > 2) { numInRange += (cend - cbeg - 2) * CHUNK_SIZE; }
+    if (cend - cbeg > 1) { numInRange += fnCountInRange(*(cend - 1)); }
+    if (cend - cbeg > 0) { numInRange += fnCountInRange(*cbeg); }
+
+    // Summaries are used only when every pixel still covers at least one of them, as the
+    //  pyramid selects its level, thus spilled history is as fine as resident one.
+    bool const bUseSummary = numInRange / SUB_BUCKET_SIZE >= numPixels;
+    bool const bUseChunkSummary = numInRange / CHUNK_SIZE >= numPixels;
+
+    auto const fnExpand
+            = [&](ChunkDesc const& chunk) {
+                  if (bUseChunkSummary) {
+                      chunk.summary.Expand(mode, sink);
+                      return;
+                  }
+
+                  for (auto& sub : chunk.subBuckets) {
+                      if (sub.timeEnd < xmin) { continue; }
+                      if (sub.timeBegin >= xmax) { break; }
+                      sub.Expand(mode, sink);
+                  }
+              };
+
+    // Chunks at both ends of range are partially covered, thus trimmed to range.
+    auto const fnEmitInRange
+            = [&](std::vector<Point> const& samples) {
+                  auto const fnLess = [](Point const& pt, steady_clock::time_point tp) { return pt.timestamp < tp; };
+                  auto begin = std::lower_bound(samples.begin(), samples.end(), xmin, fnLess);
+                  auto end = std::lower_bound(begin, samples.end(), xmax, fnLess);
+
+                  for (; begin != end; ++begin) { sink(*begin); }
+              };
+
+    for (auto iter = cbeg; iter != cend; ++iter) {
+        if (bUseSummary) {
+            fnExpand(*iter);
+        } else if (auto samples = _loadChunk(iter - _chunks.begin())) {
+            fnEmitInRange(*samples);
+        } else {
+            // Chunk is discarded; summaries are the best we have.
+            fnExpand(*iter);
+        }
+    }
+
+    if (bOpenInRange) {
+        if (bUseSummary) {
+            fnExpand(_open);
+        } else {
+            fnEmitInRange(_openSamples);
+        }
+    }
+}
+
+template <typename Sink_>
+size_t SpillStore::Snapshot::ForEach(Sink_&& sink)
+{
+    size_t numSkipped = 0;
+
+    for (auto& chunk : _chunks) {
+        if (_load(chunk))
+            for (auto& pt : _decoded) { sink(pt); }
+        else
+            numSkipped += chunk.count;
+    }
+
+    for (auto& pt : _openSamples) { sink(pt); }
+    return numSkipped;
+}
+}  // namespace TimePlot
@@ -0,0 +1,157 @@
+//
+// Created by ki608 on 2022-07-29.
+//
+
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace TimePlot {
+/**
+ * Snapshot of statistics, which is cheap to copy to main thread.
+ */
+struct StatsSummary {
+    size_t count = 0;
+    double mean = 0;
+    double stddev = 0;
+
+    double p50 = 0;
+    double p90 = 0;
+    double p95 = 0;
+    double p99 = 0;
+};
+
+/**
+ * Streaming mean, variance and quantiles over a sliding range of samples.
+ *
+ * Mean and variance are maintained with Welford's method. Quantiles are served from a
+ *  log-linear histogram, whose bins have relative width of 1/SUB_BINS per octave, thus
+ *  relative error of quantiles is bounded by about 3%. Both support removal, thus the
+ *  range can slide in O(samples entered or left).
+ */
+class StreamingStats
+{
+   public:
+    static constexpr int SUB_BINS = 16;
+    static constexpr int MIN_EXP = -63;
+    static constexpr int MAX_EXP = 64;
+    static constexpr int NUM_MAGNITUDE_BINS = (MAX_EXP - MIN_EXP + 1) * SUB_BINS;
+
+    // [negative magnitudes, reversed] [zero] [positive magnitudes]
+    static constexpr int ZERO_BIN = NUM_MAGNITUDE_BINS;
+    static constexpr int NUM_BINS = NUM_MAGNITUDE_BINS * 2 + 1;
+
+   private:
+    std::vector<uint32_t> _bins = std::vector<uint32_t>(NUM_BINS);
+
+    size_t _count = 0;
+    double _mean = 0;
+    double _m2 = 0;
+
+    // Removal accumulates rounding error of Welford's method; caller should rebuild
+    //  from scratch when this grows too large.
+    size_t _numRemoved = 0;
+
+   public:
+    size_t Count() const noexcept { return _count; }
+    bool ShouldRebuild() const noexcept { return _numRemoved > 4 * _count + 1024; }
+
+    void Clear() noexcept
+    {
+        std::fill(_bins.begin(), _bins.end(), 0);
+        _count = _numRemoved = 0;
+        _mean = _m2 = 0;
+    }
+
+    void Add(double v) noexcept
+    {
+        if (std::isnan(v)) { return; }
+
+        ++_bins[_binIndexOf(v)];
+        ++_count;
+
+        auto delta = v - _mean;
+        _mean += delta / double(_count);
+        _m2 += delta * (v - _mean);
+    }
+
+    //! Value must have been added before.
+    void Remove(double v) noexcept
+    {
+        if (std::isnan(v)) { return; }
+        if (_count <= 1) { return Clear(); }
+
+        --_bins[_binIndexOf(v)];
+        ++_numRemoved;
+
+        auto meanPrev = _mean;
+        _mean = (_mean * double(_count) - v) / double(_count - 1);
+        _m2 = std::max(0., _m2 - (v - meanPrev) * (v - _mean));
+        --_count;
+    }
+
+    double Mean() const noexcept { return _mean; }
+    double Variance() const noexcept { return _count > 1 ? _m2 / double(_count - 1) : 0.; }
+
+    /**
+     * @param q Quantile within [0, 1]
+     * @return Representative value of the bin which contains given quantile.
+     */
+    double Quantile(double q) const noexcept
+    {
+        if (_count == 0) { return 0; }
+
+        auto rank = uint64_t(std::clamp(q, 0., 1.) * double(_count - 1));
+        uint64_t accum = 0;
+
+        for (int i = 0; i < NUM_BINS; ++i) {
+            if ((accum += _bins[i]) > rank) { return _valueOfBin(i); }
+        }
+
+        return _valueOfBin(NUM_BINS - 1);
+    }
+
+    StatsSummary Summary() const noexcept
+    {
+        StatsSummary r;
+        r.count = _count;
+        r.mean = _mean;
+        r.stddev = std::sqrt(Variance());
+        r.p50 = Quantile(.50);
+        r.p90 = Quantile(.90);
+        r.p95 = Quantile(.95);
+        r.p99 = Quantile(.99);
+        return r;
+    }
+
+   private:
+    static int _binIndexOf(double v) noexcept
+    {
+        int exp;
+        auto mantissa = std::frexp(std::abs(v), &exp);  // [0.5, 1)
+
+        if (v == 0 || exp < MIN_EXP) { return ZERO_BIN; }
+        if (std::isinf(v)) { exp = MAX_EXP, mantissa = 1. - 1e-9; }
+
+        exp = std::min(exp, MAX_EXP);
+        auto sub = std::min(int((mantissa - .5) * 2 * SUB_BINS), SUB_BINS - 1);
+        auto magnitude = (exp - MIN_EXP) * SUB_BINS + sub;
+
+        return v > 0 ? ZERO_BIN + 1 + magnitude : ZERO_BIN - 1 - magnitude;
+    }
+
+    static double _valueOfBin(int index) noexcept
+    {
+        if (index == ZERO_BIN) { return 0; }
+
+        auto magnitude = index > ZERO_BIN ? index - ZERO_BIN - 1 : ZERO_BIN - 1 - index;
+        auto exp = magnitude / SUB_BINS + MIN_EXP;
+        auto sub = magnitude % SUB_BINS;
+        auto value = std::ldexp(.5 + (sub + .5) / (2. * SUB_BINS), exp);
+
+        return index > ZERO_BIN ? value : -value;
+    }
+};
+}  // namespace TimePlot
@@ -0,0 +1,98 @@
+//
+// Created by ki608 on 2022-08-01.
+//
+
+#include "FlameGraph.hpp"
+
+#include <algorithm>
+
+void Trace::LayoutFlameGraph(std::vector<FlameSample> samples, FlameLayout* out)
+{
+    out->rects.clear();
+    out->totalSeconds = 0;
+    out->numDepths = 0;
+
+    auto const numSamples = samples.size();
+    std::sort(samples.begin(), samples.end(), [](auto& a, auto& b) { return a.index < b.index; });
+
+    auto const fnFind
+            = [&](int index) -> int {
+                  auto iter = std::lower_bound(
+                          samples.begin(), samples.end(), index,
+                          [](FlameSample const& s, int i) { return s.index < i; });
+
+                  return iter != samples.end() && iter->index == index ? int(iter - samples.begin()) : -1;
+              };
+
+    // Children of sample i are children[offsets[i], offsets[i + 1]), in index order.
+    std::vector<int> parentOf(numSamples);
+    std::vector<uint32_t> offsets(numSamples + 1);
+    std::vector<int> roots;
+
+    for (size_t i = 0; i < numSamples; ++i) {
+        samples[i].seconds = std::max(0., samples[i].seconds);
+
+        if ((parentOf[i] = fnFind(samples[i].parent)) < 0) {
+            roots.push_back(int(i));
+            out->totalSeconds += samples[i].seconds;
+        } else {
+            ++offsets[parentOf[i] + 1];
+        }
+    }
+
+    if (out->totalSeconds <= 0) { return; }
+
+    for (size_t i = 0; i < numSamples; ++i) { offsets[i + 1] += offsets[i]; }
+
+    std::vector<int> children(offsets.back());
+    std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+
+    for (size_t i = 0; i < numSamples; ++i)
+        if (parentOf[i] >= 0) { children[cursors[parentOf[i]]++] = int(i); }
+
+    // Depth first; each entry is (sample, depth, start, end of parent)
+    struct Visit {
+        int sample;
+        int depth;
+        double x0;
+        double limit;
+    };
+
+    std::vector<Visit> stack;
+    out->rects.reserve(numSamples);
+
+    double rootCursor = 0;
+    for (auto root : roots) {
+        auto width = samples[root].seconds / out->totalSeconds;
+        stack.push_back({root, 0, rootCursor, rootCursor + width});
+        rootCursor += width;
+    }
+
+    std::reverse(stack.begin(), stack.end());
+
+    while (not stack.empty()) {
+        auto visit = stack.back();
+        stack.pop_back();
+
+        auto& sample = samples[visit.sample];
+        auto x1 = std::min(visit.x0 + sample.seconds / out->totalSeconds, visit.limit);
+        if (x1 <= visit.x0) { continue; }
+
+        out->rects.push_back({sample.index, sample.nameId, visit.depth, visit.x0, x1, sample.seconds});
+        out->numDepths = std::max(out->numDepths, visit.depth + 1);
+
+        // Push children in reverse, thus they are popped in index order.
+        auto const begin = offsets[visit.sample];
+        auto const end = offsets[visit.sample + 1];
+        auto childCursor = visit.x0;
+
+        auto const stackBase = stack.size();
+        for (auto i = begin; i != end; ++i) {
+            auto child = children[i];
+            stack.push_back({child, visit.depth + 1, childCursor, x1});
+            childCursor += samples[child].seconds / out->totalSeconds;
+        }
+
+        std::reverse(stack.begin() + stackBase, stack.end());
+    }
+}
@@ -0,0 +1,49 @@
+//
+// Created by ki608 on 2022-08-01.
+//
+
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace Trace {
+/**
+ * Duration of a trace node, captured at a fence.
+ */
+struct FlameSample {
+    int index = 0;
+    int parent = -1;
+    uint32_t nameId = 0;
+    double seconds = 0;
+};
+
+/**
+ * Laid out node. Horizontal range is normalized to [0, 1] of sum of root durations.
+ */
+struct FlameRect {
+    int index = 0;
+    uint32_t nameId = 0;
+    int depth = 0;
+    double x0 = 0;
+    double x1 = 0;
+    double seconds = 0;
+};
+
+struct FlameLayout {
+    uint64_t fence = 0;
+    double totalSeconds = 0;
+    int numDepths = 0;
+
+    // In depth first order, thus each parent precedes its children.
+    std::vector<FlameRect> rects;
+};
+
+/**
+ * Lays out icicle graph, where roots are on top and children are placed left to right
+ *  from start of their parent, in order of node index.
+ *
+ * Samples whose parent is not sampled are regarded as roots. Children which overflow
+ *  their parent, e.g. concurrent scopes, are clipped at the end of the parent.
+ */
+void LayoutFlameGraph(std::vector<FlameSample> samples, FlameLayout* out);
+}  // namespace Trace
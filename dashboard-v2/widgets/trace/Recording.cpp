@@ -0,0 +1,266 @@
+//
+// Created by ki608 on 2022-08-03.
+//
+
+#include "Recording.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+using namespace Trace;
+
+// Guards allocation against corrupted fields.
+constexpr uint32_t MAX_STRING_LENGTH = 1 << 24;
+
+template <typename T>
+void Put(std::string* out, T const& value)
+{
+    out->append((char const*)&value, sizeof value);
+}
+
+template <typename T>
+bool Get(std::istream& in, T* out)
+{
+    return bool(in.read((char*)out, sizeof *out));
+}
+
+void PutEntry(std::string* out, RecordEntry const& e)
+{
+    Put(out, e.index);
+    Put(out, e.fence);
+    Put(out, uint8_t(e.bSubscribed));
+    Put(out, uint8_t(e.payload.index()));
+
+    auto fnVisitor =
+            [&](auto&& value) {
+                using ValueType = std::decay_t<decltype(value)>;
+
+                if constexpr (std::is_same_v<ValueType, std::nullptr_t>) {
+                    // No content
+                } else if constexpr (std::is_same_v<ValueType, steady_clock::duration>) {
+                    Put(out, int64_t(value.count()));
+                } else if constexpr (std::is_same_v<ValueType, std::string>) {
+                    Put(out, uint32_t(value.size()));
+                    out->append(value);
+                } else if constexpr (std::is_same_v<ValueType, bool>) {
+                    Put(out, uint8_t(value));
+                } else {
+                    Put(out, value);
+                }
+            };
+
+    std::visit(fnVisitor, e.payload);
+}
+
+bool GetEntry(std::istream& in, RecordEntry* e)
+{
+    uint8_t bSubscribed, type;
+    if (not Get(in, &e->index) || not Get(in, &e->fence) || not Get(in, &bSubscribed) || not Get(in, &type))
+        return false;
+
+    e->bSubscribed = bSubscribed;
+
+    switch (type) {
+        case 0: {
+            e->payload = nullptr;
+            return true;
+        }
+
+        case 1: {
+            int64_t count;
+            if (not Get(in, &count)) { return false; }
+            return e->payload = steady_clock::duration{count}, true;
+        }
+
+        case 2: {
+            int64_t value;
+            if (not Get(in, &value)) { return false; }
+            return e->payload = value, true;
+        }
+
+        case 3: {
+            double value;
+            if (not Get(in, &value)) { return false; }
+            return e->payload = value, true;
+        }
+
+        case 4: {
+            uint32_t length;
+            if (not Get(in, &length) || length > MAX_STRING_LENGTH) { return false; }
+
+            std::string value(length, '\0');
+            if (not in.read(value.data(), length)) { return false; }
+            return e->payload = std::move(value), true;
+        }
+
+        case 5: {
+            uint8_t value;
+            if (not Get(in, &value)) { return false; }
+            return e->payload = bool(value), true;
+        }
+
+        default:
+            return false;
+    }
+}
+}  // namespace
+
+bool Trace::RecordWriter::Open(std::filesystem::path const& base)
+{
+    _data.open(Recording::DataPath(base), std::ios::out | std::ios::binary | std::ios::trunc);
+    _index.open(Recording::IndexPath(base), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (not _data.is_open() || not _index.is_open()) { return false; }
+
+    _data.write(Recording::MAGIC, sizeof Recording::MAGIC);
+    _data.flush();
+
+    _offset = sizeof Recording::MAGIC;
+    _numRecords = 0;
+    _latest.clear();
+    _hasLatest.clear();
+
+    return Good();
+}
+
+bool Trace::RecordWriter::Append(std::vector<RecordEntry> const& batch)
+{
+    if (batch.empty()) { return Good(); }
+
+    auto const fnInRange = [](RecordEntry const& e) { return e.index < Recording::MAX_NODE_INDEX; };
+
+    uint64_t fence = 0;
+    for (auto& e : batch) {
+        if (not fnInRange(e)) { continue; }
+        fence = std::max(fence, e.fence);
+
+        if (_latest.size() <= e.index) {
+            _latest.resize(e.index + 1);
+            _hasLatest.resize(e.index + 1);
+        }
+
+        _latest[e.index] = e;
+        _hasLatest[e.index] = true;
+    }
+
+    bool const bKeyframe = _numRecords % Recording::KEYFRAME_INTERVAL == 0;
+    if (bKeyframe) { _keyframeOffset = _offset; }
+
+    _buffer.clear();
+    Put(&_buffer, fence);
+
+    if (bKeyframe) {
+        Put(&_buffer, uint32_t(std::count(_hasLatest.begin(), _hasLatest.end(), true)));
+
+        for (size_t i = 0; i < _latest.size(); ++i)
+            if (_hasLatest[i]) { PutEntry(&_buffer, _latest[i]); }
+    } else {
+        Put(&_buffer, uint32_t(std::count_if(batch.begin(), batch.end(), fnInRange)));
+
+        for (auto& e : batch)
+            if (fnInRange(e)) { PutEntry(&_buffer, e); }
+    }
+
+    // Record must be complete before it is indexed, as reader may follow.
+    _data.write(_buffer.data(), std::streamsize(_buffer.size()));
+    _data.flush();
+    if (not _data.good()) { return false; }
+
+    uint64_t indexEntry[] = {fence, _offset, _keyframeOffset};
+    _index.write((char const*)indexEntry, sizeof indexEntry);
+    _index.flush();
+    if (not _index.good()) { return false; }
+
+    _offset += _buffer.size();
+    ++_numRecords;
+    return true;
+}
+
+bool Trace::RecordReader::Open(std::filesystem::path const& base)
+{
+    _indexPath = Recording::IndexPath(base);
+    _data.open(Recording::DataPath(base), std::ios::in | std::ios::binary);
+    _index.open(_indexPath, std::ios::in | std::ios::binary);
+    if (not _data.is_open() || not _index.is_open()) { return false; }
+
+    char magic[sizeof Recording::MAGIC];
+    return _data.read(magic, sizeof magic) && memcmp(magic, Recording::MAGIC, sizeof magic) == 0;
+}
+
+size_t Trace::RecordReader::NumRecords() const
+{
+    std::error_code ec;
+    auto size = std::filesystem::file_size(_indexPath, ec);
+    return ec ? 0 : size_t(size / Recording::INDEX_ENTRY_SIZE);
+}
+
+uint64_t Trace::RecordReader::FenceAt(size_t record)
+{
+    uint64_t entry[3];
+    return _readIndex(record, entry) ? entry[0] : 0;
+}
+
+size_t Trace::RecordReader::Find(uint64_t fence)
+{
+    size_t lo = 0, hi = NumRecords();
+
+    while (lo < hi) {
+        auto mid = lo + (hi - lo) / 2;
+        if (FenceAt(mid) < fence)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+bool Trace::RecordReader::ReadState(size_t record, std::vector<RecordEntry>* out)
+{
+    uint64_t entry[3];
+    if (not _readIndex(record, entry)) { return false; }
+
+    auto const offset = entry[1];
+    auto const keyframeOffset = entry[2];
+
+    // Replay from keyframe up to the record, keeping latest entry of each node.
+    std::vector<RecordEntry> state;
+    std::vector<bool> present;
+
+    _data.clear();
+    _data.seekg(std::streamoff(keyframeOffset));
+
+    for (auto at = keyframeOffset; at <= offset;) {
+        uint64_t fence;
+        uint32_t numEntries;
+        if (not Get(_data, &fence) || not Get(_data, &numEntries)) { return false; }
+
+        for (uint32_t i = 0; i < numEntries; ++i) {
+            RecordEntry e;
+            if (not GetEntry(_data, &e) || e.index >= Recording::MAX_NODE_INDEX) { return false; }
+
+            if (state.size() <= e.index) {
+                state.resize(e.index + 1);
+                present.resize(e.index + 1);
+            }
+
+            present[e.index] = true;
+            state[e.index] = std::move(e);
+        }
+
+        at = uint64_t(_data.tellg());
+    }
+
+    out->clear();
+    for (size_t i = 0; i < state.size(); ++i)
+        if (present[i]) { out->push_back(std::move(state[i])); }
+
+    return true;
+}
+
+bool Trace::RecordReader::_readIndex(size_t record, uint64_t (&entry)[3])
+{
+    _index.clear();
+    _index.seekg(std::streamoff(record * Recording::INDEX_ENTRY_SIZE));
+    return bool(_index.read((char*)entry, sizeof entry));
+}
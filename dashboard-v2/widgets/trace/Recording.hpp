@@ -0,0 +1,110 @@
+//
+// Created by ki608 on 2022-08-03.
+//
+
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace Trace {
+using std::chrono::steady_clock;
+
+/**
+ * Payload of a recorded node. Holds same alternatives as trace update payload, though
+ *  doesn't depend on protocol, thus the file format is fixed regardless of it.
+ */
+using RecordPayload = std::variant<std::nullptr_t, steady_clock::duration, int64_t, double, std::string, bool>;
+
+struct RecordEntry {
+    uint32_t index = 0;
+    uint64_t fence = 0;
+    bool bSubscribed = false;
+    RecordPayload payload;
+};
+
+/**
+ * Append-only recording of trace update batches of a tracer, as pair of files.
+ *
+ *      <base>.rec  := MAGIC record*
+ *      record      := u64 fence, u32 numEntries, entry*
+ *      entry       := u32 index, u64 fence, u8 bSubscribed, u8 type, payload
+ *
+ *      <base>.idx  := (u64 fence, u64 offset, u64 keyframeOffset)*
+ *
+ * Index has fixed size entries in recording order, thus a record is located by binary
+ *  search over the index file without loading it. Every KEYFRAME_INTERVAL records, a
+ *  keyframe holding latest entry of every node is written instead of the batch, so that
+ *  reading state at any record replays at most KEYFRAME_INTERVAL records.
+ */
+namespace Recording {
+constexpr char MAGIC[8] = {'P', 'K', 'T', 'R', 'A', 'C', '0', '1'};
+constexpr size_t KEYFRAME_INTERVAL = 64;
+constexpr size_t INDEX_ENTRY_SIZE = 24;
+
+// Entries beyond this are not written, and files containing them are rejected.
+constexpr uint32_t MAX_NODE_INDEX = 1 << 24;
+
+inline auto DataPath(std::filesystem::path base) { return base += ".rec"; }
+inline auto IndexPath(std::filesystem::path base) { return base += ".idx"; }
+}  // namespace Recording
+
+class RecordWriter
+{
+    std::ofstream _data;
+    std::ofstream _index;
+    uint64_t _offset = 0;
+
+    // Latest entry of every node, to write keyframes.
+    std::vector<RecordEntry> _latest;
+    std::vector<bool> _hasLatest;
+
+    size_t _numRecords = 0;
+    uint64_t _keyframeOffset = 0;
+    std::string _buffer;
+
+   public:
+    bool Open(std::filesystem::path const& base);
+
+    /**
+     * Written through to the files, thus a reader can follow while recording.
+     * @return false if any write has failed; the recording should be abandoned then.
+     */
+    bool Append(std::vector<RecordEntry> const& batch);
+
+    bool Good() const noexcept { return _data.good() && _index.good(); }
+    size_t NumRecords() const noexcept { return _numRecords; }
+};
+
+class RecordReader
+{
+    std::filesystem::path _indexPath;
+    std::ifstream _data;
+    std::ifstream _index;
+    std::string _buffer;
+
+   public:
+    bool Open(std::filesystem::path const& base);
+
+    //! Records written so far; grows while the recording is in progress.
+    size_t NumRecords() const;
+
+    uint64_t FenceAt(size_t record);
+
+    //! First record whose fence is not less than given one, in O(log n) reads.
+    size_t Find(uint64_t fence);
+
+    /**
+     * Latest entry of every node as of given record, in index order.
+     * @return false if the files are truncated or malformed.
+     */
+    bool ReadState(size_t record, std::vector<RecordEntry>* out);
+
+   private:
+    bool _readIndex(size_t record, uint64_t (&entry)[3]);
+};
+}  // namespace Trace
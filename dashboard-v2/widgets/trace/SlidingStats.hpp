@@ -0,0 +1,94 @@
+//
+// Created by ki608 on 2022-08-04.
+//
+
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace Trace {
+/**
+ * Snapshot of statistics, which is cheap to copy to main thread.
+ */
+struct WindowSummary {
+    uint32_t count = 0;
+    float min = 0;
+    float max = 0;
+    float mean = 0;
+
+    float p50 = 0;
+    float p90 = 0;
+    float p99 = 0;
+};
+
+/**
+ * Min, max, mean and quantiles over the latest LENGTH samples, in fixed memory.
+ *
+ * Samples are kept twice; in a ring by arrival order, and in an array sorted by value.
+ *  A sample costs a binary search and at most LENGTH moves to replace the oldest one,
+ *  which is cheaper than a histogram sketch for windows this small, and exact.
+ */
+class SlidingWindowStats
+{
+   public:
+    static constexpr uint32_t LENGTH = 64;
+
+   private:
+    float _ring[LENGTH] = {};
+    float _sorted[LENGTH] = {};
+    uint32_t _numPushed = 0;
+    double _sum = 0;
+
+   public:
+    uint32_t Count() const noexcept { return std::min(_numPushed, LENGTH); }
+
+    void Push(float value) noexcept
+    {
+        if (std::isnan(value)) { return; }
+
+        auto const slot = _numPushed % LENGTH;
+        auto n = Count();
+
+        if (n == LENGTH) {
+            // Evict the oldest sample
+            auto oldest = _ring[slot];
+            auto at = std::lower_bound(_sorted, _sorted + n, oldest);
+            std::copy(at + 1, _sorted + n, at);
+
+            _sum -= oldest;
+            --n;
+        }
+
+        auto at = std::upper_bound(_sorted, _sorted + n, value);
+        std::copy_backward(at, _sorted + n, _sorted + n + 1);
+        *at = value;
+
+        _ring[slot] = value;
+        _sum += value;
+        ++_numPushed;
+
+        // Rounding error of running sum is reset every full turn of the ring.
+        if (_numPushed % LENGTH == 0) {
+            _sum = 0;
+            for (auto v : _ring) { _sum += v; }
+        }
+    }
+
+    WindowSummary Summary() const noexcept
+    {
+        WindowSummary r;
+        if ((r.count = Count()) == 0) { return r; }
+
+        auto const fnQuantile = [&](double q) { return _sorted[uint32_t(q * (r.count - 1) + .5)]; };
+
+        r.min = _sorted[0];
+        r.max = _sorted[r.count - 1];
+        r.mean = float(_sum / r.count);
+        r.p50 = fnQuantile(.50);
+        r.p90 = fnQuantile(.90);
+        r.p99 = fnQuantile(.99);
+        return r;
+    }
+};
+}  // namespace Trace
@@ -0,0 +1,77 @@
+//
+// Created by ki608 on 2022-08-02.
+//
+
+#include "Snapshot.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void Trace::Snapshot::Add(std::string_view path, double value, uint64_t fence, bool bDuration)
+{
+    _entries.push_back({uint32_t(_paths.size()), uint32_t(path.size()), value, fence, bDuration});
+    _paths += path;
+}
+
+void Trace::Snapshot::Seal()
+{
+    std::sort(_entries.begin(), _entries.end(),
+              [this](Entry const& a, Entry const& b) { return PathOf(a) < PathOf(b); });
+
+    _entries.shrink_to_fit();
+    _paths.shrink_to_fit();
+}
+
+void Trace::DiffSnapshots(Snapshot const& base, Snapshot const& target, std::vector<SnapshotDiffRow>* out)
+{
+    out->clear();
+
+    auto& lhs = base.Entries();
+    auto& rhs = target.Entries();
+    out->reserve(std::max(lhs.size(), rhs.size()));
+
+    using Entry = Snapshot::Entry;
+
+    auto const fnPush
+            = [&](std::string_view path, Entry const* from, Entry const* to) {
+                  auto& row = out->emplace_back();
+                  row.path = path;
+                  row.base = from ? from->value : NAN;
+                  row.target = to ? to->value : NAN;
+                  row.delta = row.target - row.base;
+                  row.percent = row.base != 0 ? row.delta / std::abs(row.base) * 100. : NAN;
+                  row.bDuration = to ? to->bDuration : from->bDuration;
+                  row.bStale = (from && base.IsStale(*from)) || (to && target.IsStale(*to));
+              };
+
+    // Both sides are sorted by path; merge them.
+    size_t i = 0, k = 0;
+    while (i < lhs.size() || k < rhs.size()) {
+        auto order = i == lhs.size()   ? 1
+                     : k == rhs.size() ? -1
+                                       : base.PathOf(lhs[i]).compare(target.PathOf(rhs[k]));
+
+        if (order < 0) {
+            fnPush(base.PathOf(lhs[i]), &lhs[i], nullptr), ++i;
+        } else if (order > 0) {
+            fnPush(target.PathOf(rhs[k]), nullptr, &rhs[k]), ++k;
+        } else {
+            fnPush(target.PathOf(rhs[k]), &lhs[i], &rhs[k]), ++i, ++k;
+        }
+    }
+
+    // Deltas of different units aren't comparable; percent is.
+    std::stable_sort(
+            out->begin(), out->end(),
+            [](SnapshotDiffRow const& a, SnapshotDiffRow const& b) {
+                bool aMissing = std::isnan(a.delta), bMissing = std::isnan(b.delta);
+                if (aMissing != bMissing) { return bMissing; }
+
+                bool aNoPercent = std::isnan(a.percent), bNoPercent = std::isnan(b.percent);
+                if (aNoPercent != bNoPercent) { return bNoPercent; }
+                if (not aNoPercent) { return a.percent > b.percent; }
+
+                if (a.bDuration != b.bDuration) { return a.bDuration; }
+                return a.delta > b.delta;
+            });
+}
@@ -0,0 +1,77 @@
+//
+// Created by ki608 on 2022-08-02.
+//
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Trace {
+/**
+ * Numeric payloads of every node of a tracer at a fence. Nodes are keyed by their path,
+ *  e.g. `frame.update.physics`, thus snapshots of different sessions are comparable.
+ *  Nodes which weren't updated at the fence keep the fence of their latest value, thus
+ *  stale values can be told apart.
+ *
+ * Paths are packed into a single buffer. Entries are sorted by path once sealed, and the
+ *  snapshot is shared as immutable afterwards.
+ */
+class Snapshot
+{
+   public:
+    struct Entry {
+        uint32_t pathOffset = 0;
+        uint32_t pathLength = 0;
+        double value = 0;
+        uint64_t fence = 0;
+        bool bDuration = false;  // Value is in seconds
+    };
+
+   private:
+    std::string _label;
+    uint64_t _fence = 0;
+
+    std::string _paths;
+    std::vector<Entry> _entries;
+
+   public:
+    Snapshot(std::string label, uint64_t fence) : _label(std::move(label)), _fence(fence) {}
+
+    void Add(std::string_view path, double value, uint64_t fence, bool bDuration);
+    void Seal();
+
+    auto const& Label() const noexcept { return _label; }
+    auto Fence() const noexcept { return _fence; }
+    auto const& Entries() const noexcept { return _entries; }
+
+    std::string_view PathOf(Entry const& e) const noexcept
+    {
+        return std::string_view{_paths}.substr(e.pathOffset, e.pathLength);
+    }
+
+    bool IsStale(Entry const& e) const noexcept { return e.fence != _fence; }
+};
+
+struct SnapshotDiffRow {
+    std::string_view path;  // Refers either snapshot
+
+    // NaN if the node doesn't exist on that side
+    double base = 0;
+    double target = 0;
+
+    double delta = 0;
+    double percent = 0;  // NaN if base is zero
+
+    bool bDuration = false;
+    bool bStale = false;  // Either side wasn't updated at the fence of its snapshot
+};
+
+/**
+ * Joins two sealed snapshots by path. Rows are sorted by percent descending, thus the worst
+ *  regression comes first regardless of unit. Rows without percent follow, sorted by delta
+ *  within durations and other numbers each; nodes missing on either side come last.
+ */
+void DiffSnapshots(Snapshot const& base, Snapshot const& target, std::vector<SnapshotDiffRow>* out);
+}  // namespace Trace